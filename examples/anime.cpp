@@ -906,14 +906,14 @@ void mainImage(out glm::vec4 fragColor, in glm::vec2 fragCoord )
  * @param uniforms uniform variables
  */
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
-  auto const& vp   = si.uniforms[0].m4;
+  auto const& vp   = si.uniform(0).m4;
 
   auto&vCoord = outVertex.attributes[0].v2;
   auto&vPos   = outVertex.attributes[1].v3;
   auto&voff   = outVertex.attributes[2].u1;
 
   auto gl_VertexID = inVertex.gl_VertexID;
-  auto time = si.uniforms[1].v1;
+  auto time = si.uniform(1).v1;
   
   const glm::vec2 vertices[] = {
     glm::vec2(-1.f,-1.f),
@@ -967,7 +967,7 @@ glm::vec4 angryTexture(glm::vec2 uv,uint32_t voff,float iTime){
 void fragmentShader(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si){
   auto const& vCoord = inFragment.attributes[0].v2;
   auto const& voff = inFragment.attributes[2].u1;
-  auto iTime = si.uniforms[1].v1;
+  auto iTime = si.uniform(1).v1;
   outFragment.gl_FragColor= angryTexture(vCoord,voff,iTime);
 }
 
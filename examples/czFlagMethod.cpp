@@ -44,9 +44,9 @@ class Method: public ::Method{
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
   auto const& pos   = inVertex.attributes[0].v2;
   auto const& coord = inVertex.attributes[1].v2;
-  auto const& mvp   = si.uniforms[0].m4;
+  auto const& mvp   = si.uniform(0).m4;
 
-  auto time = si.uniforms[1].v1;
+  auto time = si.uniform(1).v1;
   
   auto z = (coord.x*0.5f)*glm::sin(coord.x*10.f + time);
   outVertex.gl_Position = mvp*glm::vec4(pos,z,1.f);
@@ -9,6 +9,7 @@
 #include <framework/programContext.hpp>
 #include <student/drawModel.hpp>
 #include <examples/modelMethod.hpp>
+#include <framework/frameCache.hpp>
 
 namespace modelMethod{
 
@@ -19,7 +20,9 @@ Method::Method(MethodConstructionData const*){
   modelData.load(ProgramContext::get().args.modelFile);
   model = modelData.getModel();
 
-  prepareModel(mem,commandBuffer,model);
+  prepareModel(mem,commandBuffer,model,cache);
+  prepareDrawSorter(mem,cache.firstDraw,model,sorter);
+  commandBuffer.executionMode = ProgramContext::get().args.executionMode;
 }
 
 
@@ -36,9 +39,27 @@ void Method::onDraw(Frame&frame,SceneParam const&sceneParam){
   mem.uniforms[0].m4 = sceneParam.proj * sceneParam.view;
   mem.uniforms[1].v3 = sceneParam.light;
   mem.uniforms[2].v3 = sceneParam.camera;
+  updateModelCache(mem,model,cache);
+  if(ProgramContext::get().args.sortDraws)
+    sortDraws(mem,commandBuffer,sorter,sceneParam.view);
   gpu_execute(mem,commandBuffer);
 }
 
+/**
+ * @brief This function returns fingerprint of the next frame.
+ * Model scene is static, the frame changes only if scene parameters, model or gpu memory change.
+ *
+ * @param sceneParam scene parameters
+ *
+ * @return fingerprint
+ */
+uint64_t Method::frameFingerprint(SceneParam const&sceneParam){
+  auto hash = fingerprint(sceneParam);
+  hash = fingerprint(model,hash);
+  hash = fingerprint(mem,commandBuffer,hash);
+  return hash;
+}
+
 EntryPoint main = [](){registerMethod<Method>("izg13 model loader");};
 
 }
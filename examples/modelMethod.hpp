@@ -2,6 +2,7 @@
 
 #include <framework/method.hpp>
 #include <framework/model.hpp>
+#include <student/drawModel.hpp>
 
 namespace modelMethod{
 
@@ -16,10 +17,13 @@ class Method: public ::Method{
      */
     virtual ~Method(){};
     virtual void onDraw(Frame&frame,SceneParam const&sceneParam) override;
+    virtual uint64_t frameFingerprint(SceneParam const&sceneParam) override;
     ModelData     modelData;
     Model         model;
     CommandBuffer commandBuffer;
     GPUMemory     mem;
+    ModelCache    cache;
+    DrawSorter    sorter;
 };
 
 }
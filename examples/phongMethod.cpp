@@ -8,6 +8,7 @@
 #include <framework/bunny.hpp>
 #include <framework/programContext.hpp>
 #include <framework/bunny.hpp>
+#include <framework/frameCache.hpp>
 
 namespace phongMethod{
 
@@ -19,12 +20,27 @@ class Method: public ::Method{
     Method(MethodConstructionData const*);
     virtual ~Method();
     virtual void onDraw(Frame&frame,SceneParam const&sceneParam) override;
+    virtual uint64_t frameFingerprint(SceneParam const&sceneParam) override;
     CommandBuffer commandBuffer;
     GPUMemory mem;
 };
 
 
 //! [PhongMethod]
+/**
+ * @brief This function represents prologue of phong method.
+ * It computes view projection matrix once per draw.
+ *
+ * @param constants output constants
+ * @param si shader interface
+ */
+void prologue(Uniform*constants,ShaderInterface const&si){
+  auto const&viewMatrix       = si.uniform(0).m4;
+  auto const&projectionMatrix = si.uniform(1).m4;
+
+  constants[0].m4 = projectionMatrix*viewMatrix;
+}
+
 /**
  * @brief This function represents vertex shader of phong method.
  *
@@ -35,10 +51,7 @@ class Method: public ::Method{
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
   auto const pos = glm::vec4(inVertex.attributes[0].v3,1.f);
   auto const&nor = inVertex.attributes[1].v3;
-  auto const&viewMatrix       = si.uniforms[0].m4;
-  auto const&projectionMatrix = si.uniforms[1].m4;
-
-  auto mvp = projectionMatrix*viewMatrix;
+  auto const&mvp = si.constants[0].m4;
 
   outVertex.gl_Position = mvp * pos;
   outVertex.attributes[0].v3 = pos;
@@ -53,8 +66,8 @@ void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface co
  * @param uniforms uniform variables
  */
 void fragmentShader(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si){
-  auto const& light          = si.uniforms[2].v3;
-  auto const& cameraPosition = si.uniforms[3].v3;
+  auto const& light          = si.uniform(2).v3;
+  auto const& cameraPosition = si.uniform(3).v3;
   auto const& vpos           = inFragment.attributes[0].v3;
   auto const& vnor           = inFragment.attributes[1].v3;
   auto vvnor = glm::normalize(vnor);
@@ -105,6 +118,7 @@ Method::Method(MethodConstructionData const*){
   mem.buffers[1].size = sizeof(bunnyIndices);
   mem.programs[0].vertexShader   = vertexShader;
   mem.programs[0].fragmentShader = fragmentShader;
+  mem.programs[0].prologue       = prologue;
   mem.programs[0].vs2fs[0]       = AttributeType::VEC3;
   mem.programs[0].vs2fs[1]       = AttributeType::VEC3;
 
@@ -121,8 +135,11 @@ Method::Method(MethodConstructionData const*){
   vao.indexOffset   = 0                ;
   vao.indexType     = IndexType::UINT32;
 
-  pushClearCommand(commandBuffer,glm::vec4(.5,.5,.5,1));
+  pushClearCommand(commandBuffer,glm::vec4(.5,.5,.5,1),10e10,true,true,true);
   pushDrawCommand (commandBuffer,sizeof(bunnyIndices)/sizeof(VertexIndex),0,vao);
+  commandBuffer.commands[1].data.drawCommand.opaque    = true;
+  commandBuffer.commands[1].data.drawCommand.blendMode = BlendMode::OFF;
+  commandBuffer.executionMode = ProgramContext::get().args.executionMode;
 }
 
 
@@ -152,5 +169,16 @@ void Method::onDraw(Frame&frame,SceneParam const&sceneParam){
 Method::~Method(){
 }
 
+/**
+ * @brief This function returns fingerprint of the next frame, the bunny is static.
+ *
+ * @param sceneParam scene parameters
+ *
+ * @return fingerprint
+ */
+uint64_t Method::frameFingerprint(SceneParam const&sceneParam){
+  return fingerprint(mem,commandBuffer,fingerprint(sceneParam));
+}
+
 EntryPoint main = [](){registerMethod<Method>("izg10 phong bunny");};
 }
@@ -34,7 +34,7 @@ class Method: public ::Method{
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
   outVertex.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
 
-  auto iTime = si.uniforms[0].v1;
+  auto iTime = si.uniform(0).v1;
 
   float ca = glm::cos(iTime*.1f);
   float sa = glm::sin(iTime*.1f);
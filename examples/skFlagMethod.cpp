@@ -32,13 +32,11 @@ class Method: public ::Method{
 void skFlag_VS(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
   outVertex.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
 
-  //fullscreen quad
+  //fullscreen quad (triangle strip)
   glm::vec2 const verts[]={
     glm::vec2(-1.f,-1.f),
     glm::vec2(+1.f,-1.f),
     glm::vec2(-1.f,+1.f),
-    glm::vec2(-1.f,+1.f),
-    glm::vec2(+1.f,-1.f),
     glm::vec2(+1.f,+1.f),
   };
 
@@ -141,8 +139,8 @@ void southKoreanFlag(vec4&fragColor, vec2 fragCoord, ivec2 iResolution)
  */
 void skFlag_FS(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si){
   auto uv = inFragment.attributes[0].v2;
-  outFragment.gl_FragColor = read_texture(si.textures[0],uv);
-  southKoreanFlag(outFragment.gl_FragColor,inFragment.gl_FragCoord, ivec2(si.uniforms[0].v2));
+  outFragment.gl_FragColor = read_texture(si.texture(0),uv);
+  southKoreanFlag(outFragment.gl_FragColor,inFragment.gl_FragCoord, ivec2(si.uniform(0).v2));
 }
 
 /**
@@ -154,7 +152,7 @@ Method::Method(MethodConstructionData const*){
   mem.programs[0].vs2fs[0]       = AttributeType::VEC2;//tex coords
 
   pushClearCommand(commandBuffer,glm::vec4(0));
-  pushDrawCommand (commandBuffer,6);
+  pushDrawCommand (commandBuffer,4,0,{},false,1,Topology::TRIANGLE_STRIP);
 }
 
 /**
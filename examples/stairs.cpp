@@ -22,11 +22,15 @@ class Method: public ::Method{
     CommandBuffer           commandBuffer       ;///< command buffer
     GPUMemory               mem                 ;///< gpu memory
     float                   time = 0.f          ;///< elapsed time
+    uint32_t                drawCommand = 0     ;///< index of the draw command in the command buffer
 };
 
 using namespace glm;
 
-void box(vec4&gl_Position,uint32_t&vMat,int offset,vec3 tt,int m,mat4 mvp,uint32_t gl_VertexID){
+uint32_t const nofBoxes = 31;///< maximal number of boxes (instances)
+static_assert(nofBoxes <= maxConstants,"every box needs one constant");
+
+void box(vec4&gl_Position,vec3 tt,mat4 mvp,uint32_t gl_VertexID){
   uint32_t const indices[] = {
     0u,1u,2u,2u,1u,3u,
     4u,5u,6u,6u,5u,7u,
@@ -35,45 +39,47 @@ void box(vec4&gl_Position,uint32_t&vMat,int offset,vec3 tt,int m,mat4 mvp,uint32
     0u,1u,4u,4u,1u,5u,
     2u,3u,6u,6u,3u,7u
   };
-  int vId = gl_VertexID-offset;
-  if(vId>=(int)(sizeof(indices)/sizeof(uint32_t))||vId<0)return;
-
-  vMat = m;
-
   vec3 pos;
   for(uint i=0u;i<3u;++i)
-    pos[i] = float((indices[vId]>>i)&1u);
+    pos[i] = float((indices[gl_VertexID]>>i)&1u);
 
   gl_Position = mvp*vec4(vec3(pos)*vec3(10,1,1)+tt,1.f);
 }
 
 /**
- * @brief Czech flag vertex shader
+ * @brief Stairs prologue, it computes view projection matrices of all boxes once per draw
  *
- * @param outVertex out vertex
- * @param inVertex in vertex
- * @param uniforms uniform variables
+ * @param constants output constants
+ * @param si shader interface
  */
-void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
-  auto const& vp   = si.uniforms[0].m4;
-
-  auto&vMat   = outVertex.attributes[0].u1;
-
-  auto gl_VertexID = inVertex.gl_VertexID;
-  auto iTime = si.uniforms[1].v1;
+void prologue(Uniform*constants,ShaderInterface const&si){
+  auto const& vp   = si.uniform(0).m4;
 
-  outVertex.gl_Position = vec4(0.f,0.f,0.f,1.f);
-  int N=int((sin(iTime)*0.5+.5f)*30+1);
-  for(int i=0;i<N;++i){
+  for(uint32_t i=0;i<nofBoxes;++i){
     mat4 rr = mat4(1);
     float c=cos(radians(10.f)*i);
     float s=sin(radians(10.f)*i);
     rr[0] = vec4(c,0,s,0);
     rr[2] = vec4(-s,0,c,0);
-    
-    box(outVertex.gl_Position,vMat,36*i,vec3(0,i-15,0),i,vp*rr,gl_VertexID);
+    constants[i].m4 = vp*rr;
   }
+}
+
+/**
+ * @brief Czech flag vertex shader
+ *
+ * @param outVertex out vertex
+ * @param inVertex in vertex
+ * @param uniforms uniform variables
+ */
+void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
+  auto&vMat   = outVertex.attributes[0].u1;
+
+  auto gl_VertexID   = inVertex.gl_VertexID;
+  auto i             = inVertex.gl_InstanceID;
 
+  vMat = i;
+  box(outVertex.gl_Position,vec3(0,float(i)-15,0),si.constants[i].m4,gl_VertexID);
 }
 
 /**
@@ -94,10 +100,12 @@ Method::Method(MethodConstructionData const*){
 
   mem.programs[0].vertexShader   = vertexShader;
   mem.programs[0].fragmentShader = fragmentShader;
+  mem.programs[0].prologue       = prologue;
   mem.programs[0].vs2fs[0]       = AttributeType::UINT;
 
   pushClearCommand(commandBuffer,glm::vec4(.1,.1,.1,1));
-  pushDrawCommand (commandBuffer,6*6*100,0);
+  drawCommand = commandBuffer.nofCommands;
+  pushDrawCommand (commandBuffer,6*6,0,{},false,1);
 }
 
 void Method::onUpdate(float dt){
@@ -107,7 +115,7 @@ void Method::onUpdate(float dt){
 void Method::onDraw(Frame&frame,SceneParam const&sceneParam){
   mem.framebuffer = frame;
   mem.uniforms[0].m4 = sceneParam.proj*sceneParam.view;
-  mem.uniforms[1].v1 = time;
+  commandBuffer.commands[drawCommand].data.drawCommand.nofInstances = uint32_t((sin(time)*0.5+.5f)*(nofBoxes-1)+1);
   gpu_execute(mem,commandBuffer);
 }
 
@@ -32,13 +32,11 @@ class Method: public ::Method{
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
   outVertex.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
 
-  //fullscreen quad
+  //fullscreen quad (triangle strip)
   glm::vec2 const verts[]={
     glm::vec2(-1.f,-1.f),
     glm::vec2(+1.f,-1.f),
     glm::vec2(-1.f,+1.f),
-    glm::vec2(-1.f,+1.f),
-    glm::vec2(+1.f,-1.f),
     glm::vec2(+1.f,+1.f),
   };
 
@@ -55,7 +53,7 @@ void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface co
  */
 void fragmentShader(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si){
   auto uv = inFragment.attributes[0].v2;
-  outFragment.gl_FragColor = read_texture(si.textures[0],uv);
+  outFragment.gl_FragColor = read_texture(si.texture(0),uv);
 }
 
 /**
@@ -70,7 +68,7 @@ Method::Method(MethodConstructionData const*){
   mem.programs[0].vs2fs[0]       = AttributeType::VEC2;//tex coords
 
   pushClearCommand(commandBuffer,glm::vec4(0,0,0,1));
-  pushDrawCommand (commandBuffer,6);
+  pushDrawCommand (commandBuffer,4,0,{},false,1,Topology::TRIANGLE_STRIP);
 }
 
 /**
@@ -32,8 +32,8 @@ class Method: public ::Method{
 void vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
   outVertex.gl_Position = glm::vec4(0.f,0.f,0.f,1.f);
 
-  glm::mat4 viewMatrix       = si.uniforms[3].m4;
-  glm::mat4 projectionMatrix = si.uniforms[2].m4;
+  glm::mat4 viewMatrix       = si.uniform(3).m4;
+  glm::mat4 projectionMatrix = si.uniform(2).m4;
  
   glm::mat4 mvp = projectionMatrix * viewMatrix;
 
@@ -7,6 +7,10 @@
 
 #include <assert.h>
 #include <framework/application.hpp>
+#include <framework/frameCache.hpp>
+#include <student/postProcess.hpp>
+
+uint32_t const cachedFrameDelay = 5;///< delay in ms of the main loop if the cached frame is presented
 
 
 
@@ -69,7 +73,10 @@ void Application::createMethodIfItDoesNotExist(){
   if(mr.method)return;
   int w,h;
   SDL_GetWindowSize(getWindow(),&w,&h);
-  framebuffer = std::make_shared<Framebuffer>(w,h);
+  auto const&args = ProgramContext::get().args;
+  framebuffer = std::make_shared<Framebuffer>(w,h,args.frameLayout,args.samples);
+  framebuffer->depthFormat = args.depthFormat;
+  frameFingerprint = 0;
 
   mr.method = mr.methodFactories[mr.selectedMethod](&*mr.methodConstructData[mr.selectedMethod]);
   SDL_SetWindowTitle(getWindow(),mr.methodName.at(mr.selectedMethod).c_str());
@@ -88,7 +95,24 @@ void Application::idle(){
   sceneParam.light  = light;
 
   auto frame = framebuffer->getFrame();
+
+  auto fingerprint = mr.method->frameFingerprint(sceneParam);
+  if(fingerprint){
+    fingerprint = fnv1a(frame.width ,fingerprint);
+    fingerprint = fnv1a(frame.height,fingerprint);
+  }
+
+  //nothing has changed, the previous frame is presented again
+  if(fingerprint && fingerprint == frameFingerprint){
+    swap();
+    SDL_Delay(cachedFrameDelay);
+    return;
+  }
+
   mr.method->onDraw(frame,sceneParam);
+  gpu_resolve(frame);
+  if(ProgramContext::get().args.fxaa)postProcess(frame,fxaaFilter());
+  frameFingerprint = fingerprint;
 
   swap();
 }
@@ -102,6 +126,7 @@ void Application::resize(SDL_Event const&event){
   if(mr.method){
     framebuffer->resize(event.window.data1,event.window.data2);
   }
+  frameFingerprint = 0;
   reInitRenderer();
 }
 
@@ -172,7 +197,7 @@ void Application::keyDown(SDL_Event const&event){
 }
 
 void Application::swap(){
-  auto       frame = framebuffer->color.data();
+  auto       frame = framebuffer->getLinearColor();
   auto const w     = framebuffer->width;
   auto const h     = framebuffer->height; 
 
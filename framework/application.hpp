@@ -53,6 +53,7 @@ class Application: protected Window{
     float                          orbitZoomSpeed    = 0.1f                     ;
 
     Timer<float>                   timer                                        ;
+    uint64_t                       frameFingerprint  = 0                        ;///< fingerprint of the presented frame, 0 - no cached frame
 
     std::shared_ptr<Framebuffer>framebuffer;///< framebuffer
 };
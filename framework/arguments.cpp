@@ -16,11 +16,42 @@ Arguments::Arguments(int argc,char const*argv[]){
   perfTests           = args->getu32   ("-f"          ,10,"number of frames that are tests during performance tests");
   mseThreshold        = args->getf32   ("--mse"       ,40,"mse threshold for image to image test");
   testToBreak         = args->geti32   ("--breakTest" ,-1,"this will forcefully break test with this number");
+  auto layout         = args->gets     ("--layout"    ,"linear","memory layout of framebuffer of the app and performance tests: linear or tiled");
+  auto depth          = args->gets     ("--depth"     ,"float32","format of depth buffer of the app and performance tests: float32, unorm16 or unorm24");
+  samples             = args->getu32   ("--samples"   ,1,"number of samples per pixel of the app, 4 enables multisampling");
+  fxaa                = args->isPresent("--fxaa"      ,"runs FXAA post process filter after every frame of the app and performance tests");
+  auto mode           = args->gets     ("--execution-mode","forward","execution mode of command buffers of model and phong methods: forward, prepass or visibility");
+  sortDraws           = args->isPresent("--sort-draws","sorts draws of model method by view depth every frame, it pays off in forward execution mode");
 
 
   auto printHelp  = args->isPresent("-h"    ,"prints help");
   printHelp |= args->isPresent("--help","prints help");
 
+  if(layout == "tiled")frameLayout = FrameLayout::TILED;
+  else if(layout != "linear"){
+    std::cerr << "unknown framebuffer layout: " << layout << std::endl;
+    printHelp = true;
+  }
+
+  if(depth == "unorm16")depthFormat = DepthFormat::UNORM16;
+  else if(depth == "unorm24")depthFormat = DepthFormat::UNORM24;
+  else if(depth != "float32"){
+    std::cerr << "unknown depth format: " << depth << std::endl;
+    printHelp = true;
+  }
+
+  if(mode == "prepass")executionMode = ExecutionMode::Z_PREPASS;
+  else if(mode == "visibility")executionMode = ExecutionMode::VISIBILITY_BUFFER;
+  else if(mode != "forward"){
+    std::cerr << "unknown execution mode: " << mode << std::endl;
+    printHelp = true;
+  }
+
+  if(samples != 1 && samples != 4){
+    std::cerr << "unsupported number of samples: " << samples << std::endl;
+    printHelp = true;
+  }
+
   if(printHelp || !args->validate()){
     std::cerr << args->toStr() << std::endl;
     stop = true;
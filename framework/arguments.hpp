@@ -8,6 +8,7 @@
 #pragma once
 
 #include <ArgumentViewer/ArgumentViewer.h>
+#include <student/fwd.hpp>
 #include <iostream>
 #include <string>
 
@@ -47,5 +48,11 @@ class Arguments{
   bool     upToTest; ///< run tests up to selected test
   float    mseThreshold;///< threshold for image test
   int32_t  testToBreak;///< if you want to forcefully break test, set it to test id
+  FrameLayout frameLayout = FrameLayout::LINEAR;///< memory layout of framebuffer of the app and performance tests
+  DepthFormat depthFormat = DepthFormat::FLOAT32;///< format of depth buffer of the app and performance tests
+  uint32_t    samples     = 1;///< number of samples per pixel of framebuffer of the app (1 or 4)
+  bool        fxaa        = false;///< should FXAA post process filter run after every frame of the app and performance tests
+  ExecutionMode executionMode = ExecutionMode::FORWARD;///< execution mode of command buffers of model and phong methods
+  bool        sortDraws   = false;///< should model method sort its draws by view depth every frame
 };
 
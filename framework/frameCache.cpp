@@ -0,0 +1,226 @@
+/*!
+ * @file
+ * @brief This file contains implementation of frame fingerprinting
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#include <framework/frameCache.hpp>
+
+/**
+ * @brief This function computes fingerprint of scene parameters
+ *
+ * @param sceneParam scene parameters
+ * @param hash hash of previous data
+ *
+ * @return hash
+ */
+uint64_t fingerprint(SceneParam const&sceneParam,uint64_t hash){
+  hash = fnv1a(sceneParam.proj  ,hash);
+  hash = fnv1a(sceneParam.view  ,hash);
+  hash = fnv1a(sceneParam.light ,hash);
+  hash = fnv1a(sceneParam.camera,hash);
+  return hash;
+}
+
+uint64_t fingerprint(VertexAttrib const&a,uint64_t hash){
+  hash = fnv1a(a.bufferID,hash);
+  hash = fnv1a(a.stride  ,hash);
+  hash = fnv1a(a.offset  ,hash);
+  hash = fnv1a(a.type    ,hash);
+  hash = fnv1a(a.divisor ,hash);
+  return hash;
+}
+
+uint64_t fingerprint(VertexArray const&vao,uint64_t hash){
+  for(auto const&a:vao.vertexAttrib)
+    hash = fingerprint(a,hash);
+  hash = fnv1a(vao.indexBufferID   ,hash);
+  hash = fnv1a(vao.indexOffset     ,hash);
+  hash = fnv1a(vao.indexType       ,hash);
+  hash = fnv1a(vao.primitiveRestart,hash);
+  return hash;
+}
+
+uint64_t fingerprint(ClearCommand const&c,uint64_t hash){
+  hash = fnv1a(c.color     ,hash);
+  hash = fnv1a(c.depth     ,hash);
+  hash = fnv1a(c.clearColor,hash);
+  hash = fnv1a(c.clearDepth,hash);
+  hash = fnv1a(c.fast      ,hash);
+  return hash;
+}
+
+uint64_t fingerprint(DrawCommand const&c,uint64_t hash){
+  hash = fnv1a(c.programID      ,hash);
+  hash = fnv1a(c.nofVertices    ,hash);
+  hash = fnv1a(c.nofInstances   ,hash);
+  hash = fnv1a(c.backfaceCulling,hash);
+  hash = fnv1a(c.topology       ,hash);
+  hash = fnv1a(c.depthOnly      ,hash);
+  hash = fnv1a(c.opaque         ,hash);
+  hash = fnv1a(c.blendMode      ,hash);
+  hash = fnv1a(c.uniformBufferID,hash);
+  hash = fnv1a(c.uniformBlock   ,hash);
+  hash = fingerprint(c.vao      ,hash);
+  return hash;
+}
+
+uint64_t fingerprint(MultiDrawCommand const&c,uint64_t hash){
+  hash = fnv1a(c.programID      ,hash);
+  hash = fnv1a(c.drawBufferID   ,hash);
+  hash = fnv1a(c.drawOffset     ,hash);
+  hash = fnv1a(c.nofDraws       ,hash);
+  hash = fnv1a(c.backfaceCulling,hash);
+  hash = fnv1a(c.topology       ,hash);
+  hash = fnv1a(c.depthOnly      ,hash);
+  hash = fnv1a(c.opaque         ,hash);
+  hash = fnv1a(c.blendMode      ,hash);
+  hash = fnv1a(c.uniformBufferID,hash);
+  hash = fingerprint(c.vao      ,hash);
+  return hash;
+}
+
+uint64_t fingerprint(Command const&c,uint64_t hash){
+  hash = fnv1a(c.type,hash);
+  switch(c.type){
+    case CommandType::CLEAR           :return fingerprint(c.data.clearCommand    ,hash);
+    case CommandType::DRAW            :return fingerprint(c.data.drawCommand     ,hash);
+    case CommandType::MULTI_DRAW      :return fingerprint(c.data.multiDrawCommand,hash);
+    case CommandType::BEGIN_QUERY     :
+    case CommandType::END_QUERY       :return fnv1a(c.data.queryCommand.queryID,hash);
+    case CommandType::BIND_FRAMEBUFFER:return fnv1a(c.data.bindFramebufferCommand.frameID,hash);
+    case CommandType::EMPTY           :break;
+  }
+  return hash;
+}
+
+uint64_t fingerprint(Program const&p,uint64_t hash){
+  hash = fnv1a(p.vertexShader  ,hash);
+  hash = fnv1a(p.fragmentShader,hash);
+  hash = fnv1a(p.prologue      ,hash);
+  for(auto const&a:p.vs2fs)
+    hash = fnv1a(a,hash);
+  return hash;
+}
+
+uint64_t fingerprint(Buffer const&b,uint64_t hash){
+  hash = fnv1a(b.data,hash);
+  hash = fnv1a(b.size,hash);
+  return hash;
+}
+
+uint64_t fingerprint(Texture const&t,uint64_t hash){
+  hash = fnv1a(t.data    ,hash);
+  hash = fnv1a(t.width   ,hash);
+  hash = fnv1a(t.height  ,hash);
+  hash = fnv1a(t.channels,hash);
+  hash = fnv1a(t.format  ,hash);
+  hash = fnv1a(t.layout  ,hash);
+  return hash;
+}
+
+uint64_t fingerprint(Frame const&f,uint64_t hash){
+  hash = fnv1a(f.color      ,hash);
+  hash = fnv1a(f.depth      ,hash);
+  hash = fnv1a(f.hiZ        ,hash);
+  hash = fnv1a(f.fastClear  ,hash);
+  hash = fnv1a(f.channels   ,hash);
+  hash = fnv1a(f.width      ,hash);
+  hash = fnv1a(f.height     ,hash);
+  hash = fnv1a(f.layout     ,hash);
+  hash = fnv1a(f.depthFormat,hash);
+  hash = fnv1a(f.samples    ,hash);
+  hash = fnv1a(f.sampleColor,hash);
+  hash = fnv1a(f.sampleDepth,hash);
+  for(auto const&a:f.attachments){
+    hash = fnv1a(a.data  ,hash);
+    hash = fnv1a(a.format,hash);
+  }
+  return hash;
+}
+
+template<typename T>
+uint64_t fingerprint(ResourceTable<T>const&table,uint64_t hash){
+  hash = fnv1a(table.size(),hash);
+  for(size_t i=0;i<table.size();++i)
+    hash = fingerprint(table[i],hash);
+  return hash;
+}
+
+/**
+ * @brief This function computes fingerprint of gpu memory and command buffer.
+ * Uniforms, uniform blocks and commands are hashed by value.
+ * Uniforms have no padding and are hashed as bytes, the table ends at the highest written uniform.
+ * Other structures are hashed field by field, so their padding and unused members of command data do not change the fingerprint.
+ * Buffers and textures are hashed by pointer and size, their content is not read.
+ * A method that rewrites content of a buffer in place has to hash the change itself.
+ *
+ * @param mem gpu memory
+ * @param cb command buffer
+ * @param hash hash of previous data
+ *
+ * @return hash
+ */
+uint64_t fingerprint(GPUMemory const&mem,CommandBuffer const&cb,uint64_t hash){
+  static_assert(sizeof(Uniform) == sizeof(glm::mat4),"Uniform has to be hashed without padding");
+  hash = fnv1a(mem.uniforms.size(),hash);
+  hash = fnv1a(mem.uniforms.data(),mem.uniforms.size()*sizeof(Uniform),hash);
+  hash = fnv1a(mem.uniformBuffers.size(),hash);
+  for(size_t i=0;i<mem.uniformBuffers.size();++i){
+    auto const&u = mem.uniformBuffers[i];
+    hash = fnv1a(u.data.data(),u.data.size(),hash);
+    hash = fnv1a(u.stride,hash);
+  }
+  hash = fingerprint(mem.buffers    ,hash);
+  hash = fingerprint(mem.textures   ,hash);
+  hash = fingerprint(mem.programs   ,hash);
+  hash = fingerprint(mem.frames     ,hash);
+  hash = fingerprint(mem.framebuffer,hash);
+
+  hash = fnv1a(cb.executionMode,hash);
+  hash = fnv1a(cb.nofCommands,hash);
+  for(uint32_t i=0;i<cb.nofCommands;++i)
+    hash = fingerprint(cb.commands[i],hash);
+  return hash;
+}
+
+uint64_t fingerprint(Node const&node,uint64_t hash){
+  hash = fnv1a(node.modelMatrix,hash);
+  hash = fnv1a(node.mesh       ,hash);
+  for(auto const&c:node.children)
+    hash = fingerprint(c,hash);
+  return hash;
+}
+
+/**
+ * @brief This function computes fingerprint of model tree.
+ * Node matrices and meshes are hashed, buffers and textures are hashed by pointer and size.
+ *
+ * @param model model
+ * @param hash hash of previous data
+ *
+ * @return hash
+ */
+uint64_t fingerprint(Model const&model,uint64_t hash){
+  for(auto const&r:model.roots)
+    hash = fingerprint(r,hash);
+  for(auto const&m:model.meshes){
+    hash = fnv1a(m.indexBufferID ,hash);
+    hash = fnv1a(m.indexOffset   ,hash);
+    hash = fnv1a(m.indexType     ,hash);
+    hash = fingerprint(m.position,hash);
+    hash = fingerprint(m.normal  ,hash);
+    hash = fingerprint(m.texCoord,hash);
+    hash = fnv1a(m.nofIndices    ,hash);
+    hash = fnv1a(m.diffuseColor  ,hash);
+    hash = fnv1a(m.diffuseTexture,hash);
+    hash = fnv1a(m.doubleSided   ,hash);
+    hash = fnv1a(m.opaque        ,hash);
+  }
+  for(auto const&b:model.buffers)
+    hash = fingerprint(b,hash);
+  for(auto const&t:model.textures)
+    hash = fingerprint(t,hash);
+  return hash;
+}
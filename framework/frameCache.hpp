@@ -0,0 +1,54 @@
+/*!
+ * @file
+ * @brief This file contains functions for fingerprinting of frames
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <framework/method.hpp>
+
+uint64_t const fnvOffsetBasis = 14695981039346656037ull;///< initial value of FNV-1a hash
+uint64_t const fnvPrime       = 1099511628211ull       ;///< prime of FNV-1a hash
+
+/**
+ * @brief This function appends bytes to FNV-1a hash
+ *
+ * @param data data
+ * @param size size of data in bytes
+ * @param hash hash of previous data
+ *
+ * @return hash
+ */
+inline uint64_t fnv1a(void const*data,size_t size,uint64_t hash = fnvOffsetBasis){
+  auto bytes = static_cast<uint8_t const*>(data);
+  for(size_t i=0;i<size;++i){
+    hash ^= bytes[i];
+    hash *= fnvPrime;
+  }
+  return hash;
+}
+
+/**
+ * @brief This function appends value to FNV-1a hash
+ *
+ * @tparam T type of value
+ * @param value value
+ * @param hash hash of previous data
+ *
+ * @return hash
+ */
+template<typename T>
+uint64_t fnv1a(T const&value,uint64_t hash = fnvOffsetBasis){
+  return fnv1a(&value,sizeof(T),hash);
+}
+
+uint64_t fingerprint(SceneParam const&sceneParam,uint64_t hash = fnvOffsetBasis);
+
+uint64_t fingerprint(GPUMemory const&mem,CommandBuffer const&cb,uint64_t hash = fnvOffsetBasis);
+
+uint64_t fingerprint(Model const&model,uint64_t hash = fnvOffsetBasis);
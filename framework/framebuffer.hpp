@@ -4,6 +4,7 @@
 
 #include<memory>
 #include<vector>
+#include<limits>
 
 /**
  * @brief This class represents framebuffer.
@@ -11,30 +12,86 @@
  */
 class Framebuffer{
   public:
-    Framebuffer(uint32_t w = 500,uint32_t h = 500){
+    Framebuffer(uint32_t w = 500,uint32_t h = 500,FrameLayout l = FrameLayout::LINEAR,uint32_t s = 1){
+      layout  = l;
+      samples = s;
       resize(w,h);
     }
     void resize(uint32_t w,uint32_t h){
       width = w;
       height = h;
-      auto const nofPixes = w*h;
+      auto const nofTiles = ((w+hiZTileSize-1)/hiZTileSize)*((h+hiZTileSize-1)/hiZTileSize);
+      //tiled buffers are padded to whole tiles
+      auto const nofPixes = layout == FrameLayout::TILED ? nofTiles*hiZTileSize*hiZTileSize : w*h;
       auto const bytesPerPixel = 4;
       color.resize((size_t)nofPixes*bytesPerPixel,0);
-      for(size_t i=0;i<w*h;++i)color.at(i*bytesPerPixel+3)=255;
+      for(size_t i=0;i<nofPixes;++i)color.at(i*bytesPerPixel+3)=255;
       depth.resize(nofPixes,1.f);
+      if(samples > 1){
+        sampleColor.resize((size_t)nofPixes*samples*bytesPerPixel,0);
+        sampleDepth.resize((size_t)nofPixes*samples,1.f);
+      }
+      if(layout == FrameLayout::TILED)linearColor.resize((size_t)w*h*bytesPerPixel);
+      for(uint32_t i=0;i<maxColorAttachments-1;++i)
+        if(attachmentEnabled[i])attachmentData[i].resize((size_t)nofPixes*colorFormatSize(attachmentFormat[i]));
+      hiZ.assign(nofTiles,std::numeric_limits<float>::infinity());
+      clearTiles.assign(nofTiles,0);
     }
     std::vector<uint8_t>color;
     std::vector<float  >depth;
+    std::vector<float  >hiZ  ;
+    std::vector<uint8_t>clearTiles;
+    std::vector<uint8_t>linearColor;
+    std::vector<uint8_t>sampleColor;
+    std::vector<float  >sampleDepth;
+    std::vector<uint8_t>attachmentData   [maxColorAttachments-1];
+    ColorFormat         attachmentFormat [maxColorAttachments-1] = {};
+    bool                attachmentEnabled[maxColorAttachments-1] = {};
+    FastClear fastClear;
     uint32_t width    = 0;
     uint32_t height   = 0;
     uint32_t channels = 4;
+    FrameLayout layout = FrameLayout::LINEAR;
+    DepthFormat depthFormat = DepthFormat::FLOAT32;
+    uint32_t samples = 1;
     Frame getFrame(){
       Frame frame;
       frame.color    = color.data();
       frame.depth    = depth.data();
+      frame.hiZ      = hiZ.data();
+      fastClear.tiles = clearTiles.data();
+      frame.fastClear = &fastClear;
       frame.width    = width;
       frame.height   = height;
       frame.channels = channels;
+      frame.layout   = layout;
+      frame.depthFormat = depthFormat;
+      frame.samples     = samples;
+      frame.sampleColor = sampleColor.empty() ? nullptr : sampleColor.data();
+      frame.sampleDepth = sampleDepth.empty() ? nullptr : sampleDepth.data();
+      for(uint32_t i=0;i<maxColorAttachments-1;++i){
+        frame.attachments[i].data   = attachmentEnabled[i] ? attachmentData[i].data() : nullptr;
+        frame.attachments[i].format = attachmentFormat[i];
+      }
       return frame;
     }
+    /**
+     * @brief This function adds additional color attachment, it stores OutFragment::gl_FragData[i].
+     *
+     * @param i index of attachment
+     * @param format format of attachment
+     */
+    void addAttachment(uint32_t i,ColorFormat format){
+      attachmentEnabled[i] = true;
+      attachmentFormat [i] = format;
+      resize(width,height);
+    }
+    /**
+     * @brief This function returns row major color buffer, tiled frame is converted first.
+     */
+    uint8_t const*getLinearColor(){
+      if(layout == FrameLayout::LINEAR)return color.data();
+      gpu_readFrame(getFrame(),linearColor.data(),nullptr);
+      return linearColor.data();
+    }
 };
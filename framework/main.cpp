@@ -22,7 +22,7 @@ int main(int argc,char const*argv[]){
     }
 
     if(args.runPerformanceTests){
-      runPerformanceTest(args.perfTests);
+      runPerformanceTest(args.perfTests,args.frameLayout,args.depthFormat,args.fxaa);
       return 0;
     }
 
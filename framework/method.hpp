@@ -54,5 +54,14 @@ class Method{
      * @param dt delta time - time between frames
      */
     virtual void onUpdate(float dt){(void)dt;}
+    /**
+     * @brief This function returns fingerprint of everything that affects the next frame.
+     * If the fingerprint is the same as for the previous frame, onDraw is skipped and the previous frame is presented.
+     *
+     * @param sceneParam scene parameters of the next frame
+     *
+     * @return fingerprint or 0 if the method has to be drawn every frame
+     */
+    virtual uint64_t frameFingerprint(SceneParam const&sceneParam){(void)sceneParam;return 0;}
 };
 
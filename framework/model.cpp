@@ -36,6 +36,41 @@ std::string accesstorType2Str(int i){
   return "unknow";
 }
 
+/**
+ * @brief This function translates gltf accessor to vertex attribute type.
+ * Normalized 8/16-bit integer components (KHR_mesh_quantization) are supported.
+ *
+ * @param accessor gltf accessor
+ *
+ * @return attribute type or AttributeType::EMPTY if the format is not supported
+ */
+AttributeType accessorToAttributeType(tinygltf::Accessor const&accessor){
+  uint32_t components = 0;
+  switch(accessor.type){
+    case TINYGLTF_TYPE_SCALAR:components = 1;break;
+    case TINYGLTF_TYPE_VEC2  :components = 2;break;
+    case TINYGLTF_TYPE_VEC3  :components = 3;break;
+    case TINYGLTF_TYPE_VEC4  :components = 4;break;
+    default:return AttributeType::EMPTY;
+  }
+
+  //single component type of the format, components are encoded in the lowest bits
+  AttributeType scalar;
+  switch(accessor.componentType){
+    case TINYGLTF_COMPONENT_TYPE_FLOAT         :scalar = AttributeType::FLOAT  ;break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE :scalar = AttributeType::UNORM8 ;break;
+    case TINYGLTF_COMPONENT_TYPE_BYTE          :scalar = AttributeType::SNORM8 ;break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:scalar = AttributeType::UNORM16;break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT         :scalar = AttributeType::SNORM16;break;
+    default:return AttributeType::EMPTY;
+  }
+
+  //integer components are only supported as normalized values
+  if(scalar != AttributeType::FLOAT && !accessor.normalized)return AttributeType::EMPTY;
+
+  return (AttributeType)((uint32_t)scalar-1+components);
+}
+
 class ModelDataImpl{
   public:
     ModelDataImpl();
@@ -149,10 +184,13 @@ Model ModelDataImpl::getModel(){
       res.meshes.push_back({});
       auto&m_mesh = res.meshes.back();
 
+      // glTF primitives without material use default material which is opaque
+      m_mesh.opaque = true;
       if (primitive.material >= 0) {
           //std::cerr << "material: " << primitive.material << std::endl;
           auto const& mat = model.materials.at(primitive.material);
           m_mesh.doubleSided = mat.doubleSided;
+          m_mesh.opaque = mat.alphaMode == "OPAQUE";
           auto baseColorTextureIndex = mat.pbrMetallicRoughness.baseColorTexture.index;
           //std::cerr << "baseColorTexture.Index: " << baseColorTextureIndex << std::endl;
           for (size_t i = 0; i < mat.pbrMetallicRoughness.baseColorFactor.size(); ++i)
@@ -242,13 +280,8 @@ Model ModelDataImpl::getModel(){
           att->offset     = offset + accessor.byteOffset;
           att->stride     = stride;
 
-          if(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT){
-            if(accessor.type == TINYGLTF_TYPE_SCALAR)att->type = AttributeType::FLOAT;
-            if(accessor.type == TINYGLTF_TYPE_VEC2  )att->type = AttributeType::VEC2 ;
-            if(accessor.type == TINYGLTF_TYPE_VEC3  )att->type = AttributeType::VEC3 ;
-            if(accessor.type == TINYGLTF_TYPE_VEC4  )att->type = AttributeType::VEC4 ;
-            if(att->stride == 0)att->stride = sizeof(float)*(uint32_t)att->type;
-          }
+          att->type = accessorToAttributeType(accessor);
+          if(att->stride == 0)att->stride = attributeSize(att->type);
           //std::cerr << "  bufId : " << bufId       << std::endl;
           //std::cerr << "  stride: " << att->stride << std::endl;
           //std::cerr << "  offset: " << att->offset << std::endl;
@@ -226,7 +226,7 @@ void prepareNode(GPUMemory&mem,CommandBuffer&cb,Node const&node,Model const&mode
     mesh.nofVertices ...
     createDrawCall(cb)
 
-    //zapis dat do paměti (uniformy pro draw call)
+    //zapis dat do paměti (uniformní blok draw callu, mem.uniformBuffers[0].block<DrawModelUniforms>(drawID))
     ZKOBINUJ(prubeznaMatice,node.modelMatrix);
     inverzni tranponovana...
     mesh.diffuseColor
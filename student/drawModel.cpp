@@ -7,9 +7,13 @@
 #include <student/drawModel.hpp>
 #include <student/gpu.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 ///\endcond
 
-void prepareNode(GPUMemory&mem, CommandBuffer &cmd, Node const&node, Model const&model, glm::mat4 matrix) {
+void prepareNode(GPUMemory&mem, CommandBuffer &cmd, Node const&node, Model const&model, glm::mat4 matrix, uint32_t &drawID) {
     matrix *= node.modelMatrix;
     if (node.mesh >= 0) {
         Mesh mesh = model.meshes[node.mesh];
@@ -19,6 +23,8 @@ void prepareNode(GPUMemory&mem, CommandBuffer &cmd, Node const&node, Model const
         cmd.commands[cmd.nofCommands].data.drawCommand.programID = 0;
         cmd.commands[cmd.nofCommands].data.drawCommand.nofVertices = mesh.nofIndices;
         cmd.commands[cmd.nofCommands].data.drawCommand.backfaceCulling = !mesh.doubleSided;
+        cmd.commands[cmd.nofCommands].data.drawCommand.opaque = mesh.opaque;
+        cmd.commands[cmd.nofCommands].data.drawCommand.blendMode = mesh.opaque ? BlendMode::OFF : BlendMode::WEIGHTED;
 
         cmd.commands[cmd.nofCommands].data.drawCommand.vao.vertexAttrib[0] = mesh.position;
         cmd.commands[cmd.nofCommands].data.drawCommand.vao.vertexAttrib[1] = mesh.normal;
@@ -28,18 +34,23 @@ void prepareNode(GPUMemory&mem, CommandBuffer &cmd, Node const&node, Model const
         cmd.commands[cmd.nofCommands].data.drawCommand.vao.indexOffset = mesh.indexOffset;
         cmd.commands[cmd.nofCommands].data.drawCommand.vao.indexType = mesh.indexType;
 
-        glm::mat4 inverseTranspose = glm::transpose(glm::inverse(matrix));
-        mem.uniforms[5 + cmd.nofCommands * 5 + 0].m4 = matrix;
-        mem.uniforms[5 + cmd.nofCommands * 5 + 1].m4 = inverseTranspose;
-        mem.uniforms[5 + cmd.nofCommands * 5 + 2].v4 = mesh.diffuseColor;
-        mem.uniforms[5 + cmd.nofCommands * 5 + 3].i1 = mesh.diffuseTexture;
-        mem.uniforms[5 + cmd.nofCommands * 5 + 4].v1 = mesh.doubleSided;
+        // Draw id of the command selects its block in the uniform buffer
+        cmd.commands[cmd.nofCommands].data.drawCommand.uniformBufferID = 0;
+        cmd.commands[cmd.nofCommands].data.drawCommand.uniformBlock = drawID;
+
+        DrawModelUniforms &uniforms = mem.uniformBuffers[0].block<DrawModelUniforms>(drawID);
+        uniforms.model = matrix;
+        uniforms.invTransposeModel = glm::transpose(glm::inverse(matrix));
+        uniforms.diffuseColor = mesh.diffuseColor;
+        uniforms.textureID = mesh.diffuseTexture;
+        uniforms.doubleSided = mesh.doubleSided;
 
         cmd.nofCommands++;
+        drawID++;
     }
 
     for (size_t i=0;i<node.children.size();++i) {
-        prepareNode(mem, cmd, node.children[i], model, matrix);
+        prepareNode(mem, cmd, node.children[i], model, matrix, drawID);
     }
 }
 
@@ -49,20 +60,18 @@ void prepareNode(GPUMemory&mem, CommandBuffer &cmd, Node const&node, Model const
  * @param mem gpu memory
  * @param commandBuffer command buffer
  * @param model model structure
+ *
+ * @return index of the command of the first draw, draw id i is drawn by command firstDraw + i
  */
 //! [drawModel]
-void prepareModel(GPUMemory &mem, CommandBuffer &commandBuffer, Model const &model) {
+uint32_t prepareModel(GPUMemory &mem, CommandBuffer &commandBuffer, Model const &model) {
     /// \todo Tato funkce připraví command buffer pro model a nastaví správně pamět grafické karty.<br>
     /// Vaším úkolem je správně projít model a vložit vykreslovací příkazy do commandBufferu.
     /// Zároveň musíte vložit do paměti textury, buffery a uniformní proměnné, které buffer command buffer využívat.
     /// Bližší informace jsou uvedeny na hlavní stránce dokumentace a v testech.
-    commandBuffer.commands[0].type = CommandType::CLEAR;
-    commandBuffer.commands[0].data.clearCommand.color = glm::vec4(0.1f, 0.15f, 0.1f, 1.0f);
-    commandBuffer.commands[0].data.clearCommand.depth = 1e11;
-    commandBuffer.commands[0].data.clearCommand.clearColor = true;
-    commandBuffer.commands[0].data.clearCommand.clearDepth = true;
-
-    commandBuffer.nofCommands = 1;
+    // Fast clear only marks tiles, frames without fast clear state are cleared normally
+    commandBuffer.nofCommands = 0;
+    pushClearCommand(commandBuffer, glm::vec4(0.1f, 0.15f, 0.1f, 1.0f), 1e11, true, true, true);
 
 //    mem.textures = model.textures;
 //    mem.buffers = model.buffers;
@@ -75,6 +84,7 @@ void prepareModel(GPUMemory &mem, CommandBuffer &commandBuffer, Model const &mod
 
     mem.programs[0].vertexShader = drawModel_vertexShader;
     mem.programs[0].fragmentShader = drawModel_fragmentShader;
+    mem.programs[0].prologue = drawModel_prologue;
 //    mem.programs[0].vs2fs = {
 //            AttributeType::VEC3,
 //            AttributeType::VEC3,
@@ -87,12 +97,267 @@ void prepareModel(GPUMemory &mem, CommandBuffer &commandBuffer, Model const &mod
     mem.programs[0].vs2fs[3] = AttributeType::UINT;
 
     glm::mat4 jednotkovaMAtice = glm::mat4(1.f);
+    uint32_t firstDraw = commandBuffer.nofCommands;
+    uint32_t drawID = 0;
     for (const auto& root : model.roots) {
-        prepareNode(mem, commandBuffer, root, model, jednotkovaMAtice);
+        prepareNode(mem, commandBuffer, root, model, jednotkovaMAtice, drawID);
     }
+    return firstDraw;
 }
 //! [drawModel]
 
+// Collects model matrices of nodes with mesh in the same order as prepareNode creates draws
+void collectDrawMatrices(std::vector<glm::mat4> &matrices, Node const &node, glm::mat4 matrix) {
+    matrix *= node.modelMatrix;
+    if (node.mesh >= 0) {
+        matrices.push_back(matrix);
+    }
+    for (size_t i = 0; i < node.children.size(); ++i) {
+        collectDrawMatrices(matrices, node.children[i], matrix);
+    }
+}
+
+std::vector<glm::mat4> collectDrawMatrices(Model const &model) {
+    std::vector<glm::mat4> matrices;
+    for (const auto &root : model.roots) {
+        collectDrawMatrices(matrices, root, glm::mat4(1.f));
+    }
+    return matrices;
+}
+
+// Reads vec3 vertex attribute of a vertex
+glm::vec3 readVec3(GPUMemory const &mem, VertexAttrib const &attrib, uint32_t vertex) {
+    auto data = static_cast<const uint8_t*>(mem.buffers[attrib.bufferID].data) + attrib.offset + attrib.stride * vertex;
+    return *reinterpret_cast<const glm::vec3*>(data);
+}
+
+// Returns number of vertices that are used by a draw, indexed draws use vertices up to the largest index
+uint32_t nofUsedVertices(GPUMemory const &mem, DrawCommand const &cmd) {
+    VertexArray const &vao = cmd.vao;
+    if (vao.indexBufferID < 0) {
+        return cmd.nofVertices;
+    }
+
+    auto indices = static_cast<const uint8_t*>(mem.buffers[vao.indexBufferID].data) + vao.indexOffset;
+    uint32_t maxIndex = 0;
+    for (uint32_t i = 0; i < cmd.nofVertices; ++i) {
+        uint32_t index = 0;
+        if (vao.indexType == IndexType::UINT8) index = indices[i];
+        if (vao.indexType == IndexType::UINT16) index = reinterpret_cast<const uint16_t*>(indices)[i];
+        if (vao.indexType == IndexType::UINT32) index = reinterpret_cast<const uint32_t*>(indices)[i];
+        maxIndex = glm::max(maxIndex, index);
+    }
+    return cmd.nofVertices == 0 ? 0 : maxIndex + 1;
+}
+
+// Transforms vertices of a draw to world space
+void bakeDraw(GPUMemory const &mem, BakedDraw &draw, glm::mat4 const &matrix) {
+    glm::mat4 inverseTranspose = glm::transpose(glm::inverse(matrix));
+    for (uint32_t v = 0; v < draw.nofVertices; ++v) {
+        glm::vec3 position = glm::vec3(matrix * glm::vec4(readVec3(mem, draw.source.vertexAttrib[0], v), 1.0f));
+        glm::vec3 normal = glm::vec3(inverseTranspose * glm::vec4(readVec3(mem, draw.source.vertexAttrib[1], v), 0.0f));
+        for (int c = 0; c < 3; ++c) {
+            draw.vertices[v * 6 + 0 + c] = position[c];
+            draw.vertices[v * 6 + 3 + c] = normal[c];
+        }
+    }
+}
+
+/**
+ * @brief This function prepares model into memory and creates command buffer.
+ * World space vertices of draws are baked into cache and draws use program 1 that only projects them.
+ *
+ * @param mem gpu memory
+ * @param commandBuffer command buffer
+ * @param model model structure
+ * @param cache model cache, it owns baked buffers
+ */
+void prepareModel(GPUMemory &mem, CommandBuffer &commandBuffer, Model const &model, ModelCache &cache) {
+    cache.firstDraw = prepareModel(mem, commandBuffer, model);
+
+    // Program 0 is copied first, programs[1] may grow the table and move program 0
+    Program program = mem.programs[0];
+    program.vertexShader = drawModel_bakedVertexShader;
+    program.prologue = nullptr;
+    mem.programs[1] = program;
+
+    cache.matrices = collectDrawMatrices(model);
+    cache.draws.resize(cache.matrices.size());
+
+    for (uint32_t drawID = 0; drawID < cache.draws.size(); ++drawID) {
+        DrawCommand &cmd = commandBuffer.commands[cache.firstDraw + drawID].data.drawCommand;
+        BakedDraw &draw = cache.draws[drawID];
+
+        // Buffer of a draw baked by previous prepare is reused, so preparing again does not grow the buffer table
+        int32_t bufferID = draw.bufferID >= 0 ? draw.bufferID : (int32_t) mem.buffers.size();
+        draw = BakedDraw();
+
+        // Only float vec3 positions and normals can be baked, other draws stay in object space
+        if (cmd.vao.vertexAttrib[0].type != AttributeType::VEC3 || cmd.vao.vertexAttrib[1].type != AttributeType::VEC3) {
+            continue;
+        }
+
+        draw.source = cmd.vao;
+        draw.nofVertices = nofUsedVertices(mem, cmd);
+        draw.vertices.resize(draw.nofVertices * 6);
+        draw.bufferID = bufferID;
+        bakeDraw(mem, draw, cache.matrices[drawID]);
+
+        mem.buffers[draw.bufferID].data = draw.vertices.data();
+        mem.buffers[draw.bufferID].size = draw.vertices.size() * sizeof(float);
+
+        cmd.programID = 1;
+        cmd.vao.vertexAttrib[0].bufferID = draw.bufferID;
+        cmd.vao.vertexAttrib[0].offset = 0;
+        cmd.vao.vertexAttrib[0].stride = sizeof(float) * 6;
+        cmd.vao.vertexAttrib[1].bufferID = draw.bufferID;
+        cmd.vao.vertexAttrib[1].offset = sizeof(float) * 3;
+        cmd.vao.vertexAttrib[1].stride = sizeof(float) * 6;
+    }
+}
+
+/**
+ * @brief This function checks model matrices of the model and rebakes draws whose matrices changed.
+ * Uniform blocks of changed draws are updated too.
+ *
+ * @param mem gpu memory
+ * @param model model structure, it has to have the same tree as the model the cache was prepared with
+ * @param cache model cache
+ */
+void updateModelCache(GPUMemory &mem, Model const &model, ModelCache &cache) {
+    std::vector<glm::mat4> matrices = collectDrawMatrices(model);
+    for (uint32_t drawID = 0; drawID < matrices.size() && drawID < cache.matrices.size(); ++drawID) {
+        if (matrices[drawID] == cache.matrices[drawID]) {
+            continue;
+        }
+        cache.matrices[drawID] = matrices[drawID];
+
+        DrawModelUniforms &uniforms = mem.uniformBuffers[0].block<DrawModelUniforms>(drawID);
+        uniforms.model = matrices[drawID];
+        uniforms.invTransposeModel = glm::transpose(glm::inverse(matrices[drawID]));
+
+        if (cache.draws[drawID].bufferID >= 0) {
+            bakeDraw(mem, cache.draws[drawID], matrices[drawID]);
+        }
+    }
+}
+
+// Collects meshes of nodes in the same order as prepareNode creates draws
+void collectDrawMeshes(std::vector<int32_t> &meshes, Node const &node) {
+    if (node.mesh >= 0) {
+        meshes.push_back(node.mesh);
+    }
+    for (size_t i = 0; i < node.children.size(); ++i) {
+        collectDrawMeshes(meshes, node.children[i]);
+    }
+}
+
+// Computes object space bounding sphere (center, radius) of vertices used by a mesh
+glm::vec4 meshBounds(GPUMemory const &mem, Mesh const &mesh) {
+    if (mesh.position.type != AttributeType::VEC3 || mesh.nofIndices == 0) {
+        return glm::vec4(0.f);
+    }
+
+    auto indices = mesh.indexBufferID < 0 ? nullptr : static_cast<const uint8_t*>(mem.buffers[mesh.indexBufferID].data) + mesh.indexOffset;
+    glm::vec3 minCorner = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 maxCorner = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < mesh.nofIndices; ++i) {
+        uint32_t index = i;
+        if (indices && mesh.indexType == IndexType::UINT8) index = indices[i];
+        if (indices && mesh.indexType == IndexType::UINT16) index = reinterpret_cast<const uint16_t*>(indices)[i];
+        if (indices && mesh.indexType == IndexType::UINT32) index = reinterpret_cast<const uint32_t*>(indices)[i];
+        glm::vec3 position = readVec3(mem, mesh.position, index);
+        minCorner = glm::min(minCorner, position);
+        maxCorner = glm::max(maxCorner, position);
+    }
+    return glm::vec4((minCorner + maxCorner) * 0.5f, glm::length(maxCorner - minCorner) * 0.5f);
+}
+
+// Maps float to unsigned integer with the same order
+uint32_t orderedBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+/**
+ * @brief This function prepares sorting of draws created by prepareModel.
+ * Bounds of draws are computed once, draws are sorted every frame by sortDraws.
+ *
+ * @param mem gpu memory
+ * @param firstDraw index of the command of the first draw returned by prepareModel
+ * @param model model structure
+ * @param sorter draw sorter
+ */
+void prepareDrawSorter(GPUMemory const &mem, uint32_t firstDraw, Model const &model, DrawSorter &sorter) {
+    std::vector<int32_t> meshes;
+    for (const auto &root : model.roots) {
+        collectDrawMeshes(meshes, root);
+    }
+
+    sorter.bounds.resize(meshes.size());
+    sorter.draws.resize(meshes.size());
+    sorter.keys.resize(meshes.size());
+    sorter.firstDraw = firstDraw;
+    for (uint32_t drawID = 0; drawID < meshes.size(); ++drawID) {
+        sorter.bounds[drawID] = meshBounds(mem, model.meshes[meshes[drawID]]);
+    }
+}
+
+/**
+ * @brief This function reorders draws of the command buffer by view space depth of their bounds.
+ * Model matrices are read from uniform blocks of draws, so draws moved by updateModelCache are sorted correctly.
+ * Current commands are permuted, so changes made to them after prepareDrawSorter are kept.
+ *
+ * @param mem gpu memory
+ * @param commandBuffer command buffer created by prepareModel
+ * @param sorter draw sorter prepared by prepareDrawSorter
+ * @param view view matrix
+ */
+void sortDraws(GPUMemory const &mem, CommandBuffer &commandBuffer, DrawSorter &sorter, glm::mat4 const &view) {
+    uint32_t const nofDraws = static_cast<uint32_t>(sorter.draws.size());
+    // Current commands are copied, they may be already sorted, draw id of a command is its uniform block
+    for (uint32_t i = 0; i < nofDraws; ++i) {
+        sorter.draws[i] = commandBuffer.commands[sorter.firstDraw + i];
+        DrawCommand const &cmd = sorter.draws[i].data.drawCommand;
+        glm::mat4 const &model = static_cast<DrawModelUniforms const*>(mem.uniformBuffers[0].blockData(cmd.uniformBlock))->model;
+        glm::vec4 const &bounds = sorter.bounds[cmd.uniformBlock];
+
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float distance = -(view * model * glm::vec4(glm::vec3(bounds), 1.0f)).z;
+        float radius = bounds.w * scale;
+
+        // Opaque draws are sorted by the nearest point of bounds, the others by the farthest point in reverse order
+        uint64_t key;
+        if (cmd.opaque) {
+            key = static_cast<uint64_t>(orderedBits(distance - radius)) << 31;
+        } else {
+            key = uint64_t(1) << 63 | static_cast<uint64_t>(~orderedBits(distance + radius)) << 31;
+        }
+        sorter.keys[i] = key | i;
+    }
+
+    std::sort(sorter.keys.begin(), sorter.keys.end());
+
+    for (uint32_t i = 0; i < nofDraws; ++i) {
+        commandBuffer.commands[sorter.firstDraw + i] = sorter.draws[sorter.keys[i] & 0x7fffffffu];
+    }
+}
+
+/**
+ * @brief This function represents prologue of model rendering method.
+ * It runs once per draw and computes model view projection matrix of the draw.
+ *
+ * @param constants output constants
+ * @param si shader interface
+ */
+//! [drawModel_prologue]
+void drawModel_prologue(Uniform *constants, ShaderInterface const &si) {
+    // Model shaders read uniforms directly, uniforms 0-2 are always written and tests pass shader interfaces without table sizes
+    constants[0].m4 = si.uniforms[0].m4 * si.block<DrawModelUniforms>().model;
+}
+//! [drawModel_prologue]
+
 /**
  * @brief This function represents vertex shader of texture rendering method.
  *
@@ -108,20 +373,45 @@ void drawModel_vertexShader(OutVertex &outVertex, InVertex const &inVertex, Shad
     glm::vec3 position = inVertex.attributes[0].v3;
     glm::vec3 normalVecotr = inVertex.attributes[1].v3;
 
-    glm::mat4 projectionViewMatrix = si.uniforms[0].m4;
-    glm::mat4 modelMatrix = si.uniforms[10 + inVertex.gl_DrawID * 5 + 0].m4;
-    glm::mat4 inverseTransposedMatrix = si.uniforms[10 + inVertex.gl_DrawID * 5 + 1].m4;
+    DrawModelUniforms const &uniforms = si.block<DrawModelUniforms>();
+
+    // projectionView * model is computed by prologue once per draw
+    glm::mat4 const &modelViewProjectionMatrix = si.constants[0].m4;
+    glm::mat4 const &modelMatrix = uniforms.model;
+    glm::mat4 const &inverseTransposedMatrix = uniforms.invTransposeModel;
 
     outVertex.attributes[0].v3 = glm::vec3(modelMatrix * glm::vec4(position, 1.0f));
     outVertex.attributes[1].v3 = glm::vec3(inverseTransposedMatrix * glm::vec4(normalVecotr, 0.0f));
     outVertex.attributes[2].v2 = inVertex.attributes[2].v2;
 
-    outVertex.gl_Position = projectionViewMatrix * modelMatrix * glm::vec4(position, 1.0f);
+    outVertex.gl_Position = modelViewProjectionMatrix * glm::vec4(position, 1.0f);
 
     outVertex.attributes[3].u1 = inVertex.gl_DrawID;
 }
 //! [drawModel_vs]
 
+/**
+ * @brief This function represents vertex shader of model rendering method for draws baked by model cache.
+ * Positions and normals are already in world space, only view projection matrix is applied.
+ *
+ * @param outVertex output vertex
+ * @param inVertex input vertex
+ * @param si shader interface
+ */
+//! [drawModel_bakedVs]
+void drawModel_bakedVertexShader(OutVertex &outVertex, InVertex const &inVertex, ShaderInterface const &si) {
+    glm::vec3 const &position = inVertex.attributes[0].v3;
+
+    outVertex.attributes[0].v3 = position;
+    outVertex.attributes[1].v3 = inVertex.attributes[1].v3;
+    outVertex.attributes[2].v2 = inVertex.attributes[2].v2;
+
+    outVertex.gl_Position = si.uniforms[0].m4 * glm::vec4(position, 1.0f);
+
+    outVertex.attributes[3].u1 = inVertex.gl_DrawID;
+}
+//! [drawModel_bakedVs]
+
 /**
  * @brief This functionrepresents fragment shader of texture rendering method.
  *
@@ -143,14 +433,15 @@ void drawModel_fragmentShader(OutFragment &outFragment, InFragment const &inFrag
 //
 //    glm::vec3 lightPosition = glm::normalize(si.uniforms[1].v3);
 //    glm::vec3 cameraPosition = si.uniforms[2].v3;
-//    int texNumber = si.uniforms[10 + inFragment.attributes[3].u1 * 5 + 3].i1;
-//    float doubleSided = si.uniforms[10 + inFragment.attributes[3].u1 * 5 + 4].v1;
+//    DrawModelUniforms const &uniforms = si.block<DrawModelUniforms>();
+//    int texNumber = uniforms.textureID;
+//    float doubleSided = uniforms.doubleSided;
 //
 //    glm::vec4 diffuseColour;
 //    if (texNumber >= 0) {
 //        diffuseColour = read_texture(si.textures[texNumber], texCoords);
 //    } else {
-//        diffuseColour = si.uniforms[10 + inFragment.attributes[3].u1 * 5 + 2].v4;
+//        diffuseColour = uniforms.diffuseColor;
 //    }
 //
 //    auto ambient = diffuseColour * 0.2f;
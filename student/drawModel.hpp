@@ -8,10 +8,77 @@
 
 #include <student/fwd.hpp>
 
+/**
+ * @brief This struct represents uniform block of one draw of a model.
+ * Blocks are stored in mem.uniformBuffers[0], block index is the draw id.
+ */
+//! [DrawModelUniforms]
+struct DrawModelUniforms{
+  glm::mat4 model             = glm::mat4(1.f); ///< model matrix
+  glm::mat4 invTransposeModel = glm::mat4(1.f); ///< inverse transposed model matrix
+  glm::vec4 diffuseColor      = glm::vec4(1.f); ///< diffuse color (if there is no texture)
+  int32_t   textureID         = -1            ; ///< diffuse texture or -1 (no texture)
+  float     doubleSided       = 0.f           ; ///< 1.f - double sided material, 0.f - one sided
+};
+//! [DrawModelUniforms]
+
+/**
+ * @brief This struct represents one draw of a model with world space vertices baked by model cache.
+ */
+//! [BakedDraw]
+struct BakedDraw{
+  VertexArray        source         ; ///< vertex array of the mesh (object space vertices)
+  uint32_t           nofVertices = 0; ///< number of baked vertices
+  int32_t            bufferID    = -1; ///< id of buffer with baked vertices or -1 if the draw is not baked
+  std::vector<float> vertices       ; ///< baked world space position (3f) and normal (3f) of every vertex
+};
+//! [BakedDraw]
+
+/**
+ * @brief This struct represents cache of world space vertices of a model.
+ * Vertices of every draw are transformed by its model matrix once and stored in GPU buffers.
+ * The cache is rebaked if model matrices of nodes change.
+ * The cache owns data of baked buffers, so it has to live as long as the GPU memory uses them.
+ */
+//! [ModelCache]
+struct ModelCache{
+  std::vector<glm::mat4>matrices; ///< model matrices the draws were baked with, index is draw id
+  std::vector<BakedDraw>draws   ; ///< baked draws, index is draw id
+  uint32_t firstDraw = 0        ; ///< index of the command of the first draw
+};
+//! [ModelCache]
+
+/**
+ * @brief This struct represents per frame sorting of draws of a model by view depth.
+ * Opaque draws are sorted front to back (more fragments are rejected by depth test),
+ * draws that are not opaque are sorted back to front after them.
+ * Draws are sorted by compact 64 bit keys: bucket (1 bit), depth (32 bits) and current position of the draw (31 bits).
+ */
+//! [DrawSorter]
+struct DrawSorter{
+  std::vector<glm::vec4>bounds; ///< object space bounding sphere (center, radius) of every draw, index is draw id
+  std::vector<Command  >draws ; ///< copy of draw commands of the last sort, index is position before the sort
+  std::vector<uint64_t >keys  ; ///< sort keys of the last sort
+  uint32_t firstDraw = 0      ; ///< index of the command of the first draw
+};
+//! [DrawSorter]
+
 //void drawModel(Frame&frame,Model const&model,glm::mat4 const&proj,glm::mat4 const&view,glm::vec3 const&light,glm::vec3 const&camera);
 
-void prepareModel(GPUMemory&mem,CommandBuffer&commandBuffer,Model const&model);
+uint32_t prepareModel(GPUMemory&mem,CommandBuffer&commandBuffer,Model const&model);
+
+void prepareModel(GPUMemory&mem,CommandBuffer&commandBuffer,Model const&model,ModelCache&cache);
+
+void updateModelCache(GPUMemory&mem,Model const&model,ModelCache&cache);
+
+void prepareDrawSorter(GPUMemory const&mem,uint32_t firstDraw,Model const&model,DrawSorter&sorter);
+
+void sortDraws(GPUMemory const&mem,CommandBuffer&commandBuffer,DrawSorter&sorter,glm::mat4 const&view);
+
+void drawModel_prologue(Uniform*constants,ShaderInterface const&si);
 
 void drawModel_vertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si);
 
+void drawModel_bakedVertexShader(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si);
+
 void drawModel_fragmentShader(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si);
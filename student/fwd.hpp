@@ -8,15 +8,65 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cassert>
 #include <cstdint>
+#include <new>
+#include <type_traits>
 #include <vector>
 
 //#define MAKE_STUDENT_RELEASE
 
 uint32_t const maxAttributes = 4;///< maximum number of vertex/fragment attributes
+uint32_t const maxConstants  = 32;///< maximum number of constants computed by shader prologue
+uint32_t const hiZTileSize   = 8 ;///< size of tile of hierarchical depth buffer in pixels
+uint32_t const maxColorAttachments = 4;///< maximum number of color outputs of fragment shader (gl_FragColor and gl_FragData)
+
+/**
+ * @brief This enum represents memory layout of color and depth buffers of a frame.
+ */
+//! [FrameLayout]
+enum class FrameLayout{
+  LINEAR, ///< pixels are stored row by row
+  TILED , ///< hiZTileSize x hiZTileSize tiles are stored row by row, pixels of a tile are contiguous (row by row), buffers are padded to whole tiles
+};
+//! [FrameLayout]
+
+/**
+ * @brief This function returns index of a pixel in an image of the layout.
+ * Tiled images store every tile as one contiguous block.
+ *
+ * @param layout memory layout of the image
+ * @param width width of the image
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ *
+ * @return index of the pixel
+ */
+inline size_t layoutIndex(FrameLayout layout,uint32_t width,uint32_t x,uint32_t y){
+  if(layout == FrameLayout::TILED){
+    size_t const tile = x/hiZTileSize + static_cast<size_t>(y/hiZTileSize)*((width+hiZTileSize-1)/hiZTileSize);
+    return tile*hiZTileSize*hiZTileSize + (y%hiZTileSize)*hiZTileSize + x%hiZTileSize;
+  }
+  return x + static_cast<size_t>(y)*width;
+}
+
+/**
+ * @brief This enum represents format of texture channels.
+ */
+//! [TextureFormat]
+enum class TextureFormat{
+  UNORM8 , ///< 1 byte per channel, values are normalized to [0, 1]
+  UNORM16, ///< 2 bytes per channel, values are normalized to [0, 1] (16-bit depth)
+  UNORM24, ///< 1 channel in low 24 bits of 4 bytes, value is normalized to [0, 1] (24-bit depth)
+  FLOAT16, ///< half float per channel
+  FLOAT32, ///< float per channel
+};
+//! [TextureFormat]
 
 /**
  * @brief This struct represent a texture
+ * Texel (x,y) is stored at index y*width+x in FrameLayout::LINEAR,
+ * textures of frames in FrameLayout::TILED keep tiles of the frame (see Frame).
  */
 //! [Texture]
 struct Texture{
@@ -24,9 +74,24 @@ struct Texture{
   uint32_t       width    = 0      ;///< width of the texture
   uint32_t       height   = 0      ;///< height of the texture
   uint32_t       channels = 3      ;///< number of channels of the texture
+  TextureFormat  format   = TextureFormat::UNORM8;///< format of channels
+  FrameLayout    layout   = FrameLayout::LINEAR  ;///< memory layout of texels
 };
 //! [Texture]
 
+/**
+ * @brief This function returns size of texel in bytes.
+ *
+ * @param texture texture
+ *
+ * @return size of texel in bytes
+ */
+inline uint32_t texelSize(Texture const&texture){
+  uint32_t const componentSize[] = {1,2,4,2,4};
+  if(texture.format == TextureFormat::UNORM24)return 4;
+  return componentSize[(uint32_t)texture.format]*texture.channels;
+}
+
 /**
  * @brief This enum represents vertex/fragment attribute type.
  */
@@ -41,9 +106,56 @@ enum class AttributeType{
   UVEC2 = 8+2, ///< 2x 32-bit unsigned int
   UVEC3 = 8+3, ///< 3x 32-bit unsigned int
   UVEC4 = 8+4, ///< 4x 32-bit unsigned int
+  HALF      = 16+1, ///< 1x 16-bit float
+  HALF2     = 16+2, ///< 2x 16-bit floats
+  HALF3     = 16+3, ///< 3x 16-bit floats
+  HALF4     = 16+4, ///< 4x 16-bit floats
+  UNORM8    = 32+1, ///< 1x 8-bit unsigned normalized int, [0,255] -> [0,1]
+  UNORM8x2  = 32+2, ///< 2x 8-bit unsigned normalized ints
+  UNORM8x3  = 32+3, ///< 3x 8-bit unsigned normalized ints
+  UNORM8x4  = 32+4, ///< 4x 8-bit unsigned normalized ints
+  SNORM8    = 48+1, ///< 1x 8-bit signed normalized int, [-127,127] -> [-1,1]
+  SNORM8x2  = 48+2, ///< 2x 8-bit signed normalized ints
+  SNORM8x3  = 48+3, ///< 3x 8-bit signed normalized ints
+  SNORM8x4  = 48+4, ///< 4x 8-bit signed normalized ints
+  UNORM16   = 64+1, ///< 1x 16-bit unsigned normalized int, [0,65535] -> [0,1]
+  UNORM16x2 = 64+2, ///< 2x 16-bit unsigned normalized ints
+  UNORM16x3 = 64+3, ///< 3x 16-bit unsigned normalized ints
+  UNORM16x4 = 64+4, ///< 4x 16-bit unsigned normalized ints
+  SNORM16   = 80+1, ///< 1x 16-bit signed normalized int, [-32767,32767] -> [-1,1]
+  SNORM16x2 = 80+2, ///< 2x 16-bit signed normalized ints
+  SNORM16x3 = 80+3, ///< 3x 16-bit signed normalized ints
+  SNORM16x4 = 80+4, ///< 4x 16-bit signed normalized ints
 };
 //! [AttributeType]
 
+/**
+ * @brief This function returns number of components of attribute type.
+ * Lowest 3 bits of attribute type encode number of components.
+ *
+ * @param type attribute type
+ *
+ * @return number of components (0-4)
+ */
+inline uint32_t attributeComponents(AttributeType type){
+  return (uint32_t)type&7u;
+}
+
+/**
+ * @brief This function returns size of attribute type in bytes.
+ * Packed types (half, normalized) are decoded to floats during vertex fetch.
+ *
+ * @param type attribute type
+ *
+ * @return size of attribute in bytes
+ */
+inline uint32_t attributeSize(AttributeType type){
+  uint32_t const componentSize[] = {4,2,1,1,2,2};
+  uint32_t const format = (uint32_t)type>>4;
+  if(format >= sizeof(componentSize)/sizeof(uint32_t))return 0;
+  return componentSize[format]*attributeComponents(type);
+}
+
 /**
  * @brief This union represents one vertex/fragment attribute
  */
@@ -69,6 +181,7 @@ struct InVertex{
   Attribute attributes[maxAttributes]    ; ///< vertex attributes
   uint32_t  gl_VertexID               = 0; ///< vertex id
   uint32_t  gl_DrawID                 = 0; ///< draw id
+  uint32_t  gl_InstanceID             = 0; ///< instance id
 };
 //! [InVertex]
 
@@ -98,6 +211,7 @@ struct InFragment{
 //! [OutFragment]
 struct OutFragment{
   glm::vec4 gl_FragColor = glm::vec4(0.f); ///< fragment color
+  glm::vec4 gl_FragData[maxColorAttachments-1] = {}; ///< outputs of additional color attachments (Frame::attachments)
 };
 //! [OutFragment]
 
@@ -134,6 +248,17 @@ enum class IndexType{
 };
 //! [IndexType]
 
+/**
+ * @brief This enum represents how vertices of a draw are assembled into triangles
+ */
+//! [Topology]
+enum class Topology{
+  TRIANGLES     , ///< every 3 vertices form a triangle
+  TRIANGLE_STRIP, ///< every vertex forms a triangle with 2 previous vertices
+  TRIANGLE_FAN  , ///< every vertex forms a triangle with the first and the previous vertex
+};
+//! [Topology]
+
 
 /**
  * @brief This enum represents constant shader interface common for all shaders.
@@ -144,8 +269,43 @@ enum class IndexType{
  */
 //! [ShaderInterface]
 struct ShaderInterface{
-  Uniform const*uniforms = nullptr; ///< uniform variables
-  Texture const*textures = nullptr; ///< textures
+  Uniform const*uniforms     = nullptr; ///< uniform variables, only indices < nofUniforms can be read directly
+  Texture const*textures     = nullptr; ///< textures, only indices < nofTextures can be read directly
+  void    const*uniformBlock = nullptr; ///< uniform block bound to the draw or nullptr
+  Uniform const*constants    = nullptr; ///< constants computed by program prologue once per draw or nullptr
+  uint32_t      nofUniforms  = 0      ; ///< number of uniform variables
+  uint32_t      nofTextures  = 0      ; ///< number of textures
+  /**
+   * @brief This function returns uniform variable, variables that were never written are default
+   *
+   * @param i index of uniform variable
+   *
+   * @return uniform variable
+   */
+  Uniform const&uniform(uint32_t i)const{
+    static Uniform const empty = {};
+    return i < nofUniforms ? uniforms[i] : empty;
+  }
+  /**
+   * @brief This function returns texture, textures that were never written are empty
+   *
+   * @param i index of texture
+   *
+   * @return texture
+   */
+  Texture const&texture(uint32_t i)const{
+    static Texture const empty;
+    return i < nofTextures ? textures[i] : empty;
+  }
+  /**
+   * @brief This function returns uniform block bound to the draw
+   *
+   * @tparam T type of the block
+   *
+   * @return uniform block
+   */
+  template<typename T>
+  T const&block()const{return *static_cast<T const*>(uniformBlock);}
 };
 //! [ShaderInterface]
 
@@ -163,6 +323,20 @@ using VertexShader = void(*)(
     ShaderInterface const&si       );
 //! [VertexShader]
 
+/**
+ * @brief Function type for shader prologue.
+ * Prologue runs once per draw before any vertex is shaded.
+ * It derives constants from uniforms, they are shared by all vertices and fragments of the draw.
+ *
+ * @param constants output constants (maxConstants items)
+ * @param si shader interface of the draw
+ */
+//! [ShaderPrologue]
+using ShaderPrologue = void(*)(
+    Uniform              *constants,
+    ShaderInterface const&si       );
+//! [ShaderPrologue]
+
 /**
  * @brief Function type for fragment shader
  *
@@ -186,6 +360,7 @@ struct VertexAttrib{
   uint64_t      stride   = 0                   ;///< stride in bytes
   uint64_t      offset   = 0                   ;///< offset in bytes
   AttributeType type     = AttributeType::EMPTY;///< type of attribute
+  uint32_t      divisor  = 0                   ;///< 0 - attribute advances per vertex, N - attribute advances every N instances
 };
 //! [VertexAttrib]
 
@@ -199,6 +374,7 @@ struct VertexArray{
   int32_t      indexBufferID = -1;                ///< id of index buffer
   uint64_t     indexOffset   = 0 ;                ///< offset of indices
   IndexType    indexType     = IndexType::UINT32; ///< type of indices
+  bool         primitiveRestart = false;          ///< index with all bits set restarts strip/fan
 };
 //! [VertexArray]
 
@@ -211,24 +387,149 @@ struct VertexArray{
 struct Program{
   VertexShader   vertexShader   = nullptr; ///< vertex shader
   FragmentShader fragmentShader = nullptr; ///< fragment shader
+  ShaderPrologue prologue       = nullptr; ///< optional prologue, it computes si.constants once per draw
   AttributeType  vs2fs[maxAttributes] = {AttributeType::EMPTY}; ///< which attributes are interpolated from vertex shader to fragment shader
 };
 //! [Program]
 
+/**
+ * @brief This enum represents format of additional color attachment of a frame.
+ */
+//! [ColorFormat]
+enum class ColorFormat{
+  RGBA8  , ///< 4 unsigned normalized bytes, values are clamped to [0, 1]
+  RGBA16F, ///< 4 half floats
+  RGBA32F, ///< 4 floats
+};
+//! [ColorFormat]
+
+/**
+ * @brief This function returns size of pixel of color format in bytes.
+ *
+ * @param format color format
+ *
+ * @return size of pixel in bytes
+ */
+inline uint32_t colorFormatSize(ColorFormat format){
+  uint32_t const size[] = {4,8,16};
+  return size[(uint32_t)format];
+}
+
+/**
+ * @brief This structure represents additional color attachment of a frame.
+ * Attachment has one value per pixel in the layout of the frame, it is written without blending by every fragment that passes depth test.
+ */
+//! [ColorAttachment]
+struct ColorAttachment{
+  void*       data   = nullptr           ; ///< pixels of the attachment or nullptr if it is not used
+  ColorFormat format = ColorFormat::RGBA8; ///< format of pixels
+};
+//! [ColorAttachment]
+
+/**
+ * @brief This enum represents format of depth buffer of a frame.
+ * Integer formats store depth clamped to [0, 1], fragment depth is quantized once and the depth test compares integers.
+ */
+//! [DepthFormat]
+enum class DepthFormat{
+  FLOAT32, ///< 32-bit float per pixel
+  UNORM16, ///< 16-bit unsigned normalized integer per pixel, depth buffer uses half of its memory
+  UNORM24, ///< 24-bit unsigned normalized integer in low bits of 32-bit word per pixel
+};
+//! [DepthFormat]
+
+/**
+ * @brief This structure represents pending fast clear of a frame.
+ * Fast clear only marks hiZTileSize x hiZTileSize tiles as cleared,
+ * a tile is filled by the clear values when it is touched by rasterization or by gpu_resolve.
+ */
+//! [FastClear]
+struct FastClear{
+  uint8_t* tiles = nullptr; ///< pending clear of every tile (row major), written only by gpu
+  uint32_t color = 0      ; ///< packed RGBA8 clear color of pending tiles
+  float    depth = 1.f    ; ///< clear depth of pending tiles
+};
+//! [FastClear]
+
 /**
  * @brief This structure represents a frame.
  * Frame (or framebuffer) is used as output of rendering.
  */
 //! [Frame]
 struct Frame{
-  uint8_t* color    = nullptr; ///< color buffer (1 byte per channel)
-  float  * depth    = nullptr; ///< depth buffer
+  uint8_t* color    = nullptr; ///< color buffer (1 byte per channel, RGBA pixels are written as one packed 32-bit word)
+  float  * depth    = nullptr; ///< depth buffer, it is read as floats only in DepthFormat::FLOAT32
+  float  * hiZ      = nullptr; ///< max depth of every hiZTileSize x hiZTileSize tile (row major) or nullptr, it has to be reset if depth is written outside of gpu
+  FastClear*fastClear = nullptr; ///< state of fast clear or nullptr, fast clear commands are then executed as normal clears
   uint32_t channels = 4      ; ///< number of color channels
   uint32_t width    = 0      ; ///< width of frame
   uint32_t height   = 0      ; ///< height of frame
+  FrameLayout layout = FrameLayout::LINEAR; ///< memory layout of color and depth buffers, tiled frames are read by gpu_readFrame
+  DepthFormat depthFormat = DepthFormat::FLOAT32; ///< format of depth buffer, integer formats are read by gpu_readFrame
+  uint32_t samples     = 1      ; ///< samples per pixel (1 or 4), multisampled frame is rendered to sampleColor and sampleDepth and gpu_resolve averages them to color and depth
+  uint8_t* sampleColor = nullptr; ///< colors of samples, samples of a pixel are stored together
+  float  * sampleDepth = nullptr; ///< depths of samples in depthFormat, samples of a pixel are stored together
+  ColorAttachment attachments[maxColorAttachments-1]; ///< additional color attachments, attachments[i] stores OutFragment::gl_FragData[i]
 };
 //! [Frame]
 
+/**
+ * @brief This function returns texture that reads color buffer of the frame without copying.
+ * Multisampled frame is read after gpu_resolve.
+ *
+ * @param frame frame
+ *
+ * @return texture
+ */
+inline Texture frameColorTexture(Frame const&frame){
+  Texture texture;
+  texture.data     = frame.color;
+  texture.width    = frame.width;
+  texture.height   = frame.height;
+  texture.channels = 4;
+  texture.layout   = frame.layout;
+  return texture;
+}
+
+/**
+ * @brief This function returns 1 channel texture that reads depth buffer of the frame without copying (shadow maps).
+ *
+ * @param frame frame
+ *
+ * @return texture
+ */
+inline Texture frameDepthTexture(Frame const&frame){
+  TextureFormat const formats[] = {TextureFormat::FLOAT32,TextureFormat::UNORM16,TextureFormat::UNORM24};
+  Texture texture;
+  texture.data     = reinterpret_cast<uint8_t const*>(frame.depth);
+  texture.width    = frame.width;
+  texture.height   = frame.height;
+  texture.channels = 1;
+  texture.format   = formats[(uint32_t)frame.depthFormat];
+  texture.layout   = frame.layout;
+  return texture;
+}
+
+/**
+ * @brief This function returns texture that reads additional color attachment of the frame without copying (G-buffer).
+ *
+ * @param frame frame
+ * @param i index of attachment
+ *
+ * @return texture
+ */
+inline Texture frameAttachmentTexture(Frame const&frame,uint32_t i){
+  TextureFormat const formats[] = {TextureFormat::UNORM8,TextureFormat::FLOAT16,TextureFormat::FLOAT32};
+  Texture texture;
+  texture.data     = static_cast<uint8_t const*>(frame.attachments[i].data);
+  texture.width    = frame.width;
+  texture.height   = frame.height;
+  texture.channels = 4;
+  texture.format   = formats[(uint32_t)frame.attachments[i].format];
+  texture.layout   = frame.layout;
+  return texture;
+}
+
 
 /**
  * @brief This structure represents a buffer on GPU
@@ -241,20 +542,132 @@ struct Buffer{
 };
 //! [Buffer]
 
+/**
+ * @brief This structure represents a uniform buffer on GPU
+ * Uniform buffer holds array of blocks of the same type, one block is bound to one draw.
+ * The type of the blocks is fixed by the first access.
+ * Writing to a block behind the end of the buffer grows the buffer, new blocks are default constructed.
+ * References to blocks do not stay valid when the buffer grows.
+ */
+//! [UniformBuffer]
+struct UniformBuffer{
+  std::vector<uint8_t>data      ; ///< data of all blocks
+  uint32_t            stride = 0; ///< size of one block in bytes
+  /**
+   * @brief This function returns block, the buffer grows if it is needed
+   *
+   * @tparam T type of the block, it has to be the same for all accesses
+   * @param i index of block
+   *
+   * @return block
+   */
+  template<typename T>
+  T&block(uint32_t i){
+    static_assert(std::is_trivially_copyable<T>::value,"blocks are moved as bytes when the buffer grows");
+    if(stride == 0)stride = sizeof(T);
+    assert(stride == sizeof(T) && "all blocks of uniform buffer have to have the same type");
+    uint32_t const oldBlocks = nofBlocks();
+    if(i >= oldBlocks){
+      data.resize((size_t)(i+1)*stride);
+      for(uint32_t b=oldBlocks;b<=i;++b)new(data.data()+(size_t)b*stride)T{};
+    }
+    return *reinterpret_cast<T*>(data.data()+(size_t)i*stride);
+  }
+  /**
+   * @brief This function returns pointer to block
+   *
+   * @param i index of block
+   *
+   * @return pointer to block or nullptr if the block does not exist
+   */
+  void const*blockData(uint32_t i)const{
+    if(stride == 0 || data.size() < (size_t)(i+1)*stride)return nullptr;
+    return data.data()+(size_t)i*stride;
+  }
+  /**
+   * @brief This function returns number of blocks
+   *
+   * @return number of blocks
+   */
+  uint32_t nofBlocks()const{return stride == 0 ? 0 : (uint32_t)(data.size()/stride);}
+};
+//! [UniformBuffer]
+
+/**
+ * @brief This class represents a table of GPU resources.
+ * Resources are addressed by their index (handle).
+ * Writing to a resource behind the end of the table grows the table.
+ * Reading a resource that was never written returns default resource.
+ * Indices stay valid when the table grows, references to resources do not.
+ * Shaders read uniforms and textures through ShaderInterface::uniform and ShaderInterface::texture, they check indices.
+ * Unchecked indices (si.uniforms[i], si.textures[i]) have to be written before gpu_execute, only index 0 of an empty table reads default resource.
+ */
+//! [ResourceTable]
+template<typename T>
+class ResourceTable{
+  public:
+    /**
+     * @brief This function returns resource, the table grows if it is needed
+     *
+     * @param i index of resource
+     *
+     * @return resource
+     */
+    T&operator[](size_t i){
+      if(i >= resources.size())resources.resize(i+1);
+      return resources[i];
+    }
+    /**
+     * @brief This function returns resource, resources behind the table are default
+     *
+     * @param i index of resource
+     *
+     * @return resource
+     */
+    T const&operator[](size_t i)const{
+      if(i >= resources.size())return empty();
+      return resources[i];
+    }
+    /**
+     * @brief This function returns number of resources in the table
+     *
+     * @return number of resources
+     */
+    size_t size()const{return resources.size();}
+    /**
+     * @brief This function returns pointer to the first resource, it is used by shaders.
+     * Only size() resources can be read through it, empty table returns pointer to one default resource.
+     *
+     * @return pointer to resources
+     */
+    T const*data()const{return resources.empty() ? &empty() : resources.data();}
+  private:
+    /**
+     * @brief This function returns default resource that is read instead of resources that were never written
+     *
+     * @return default resource
+     */
+    static T const&empty(){
+      static T const resource;
+      return resource;
+    }
+    std::vector<T>resources;///< resources
+};
+//! [ResourceTable]
+
 /**
  * @brief This structure represents memory on GPU
  */
 //! [GPUMemory]
 struct GPUMemory{
-  uint32_t const static maxUniforms = 10000; ///< maximal number of uniforms
-  uint32_t const static maxTextures = 1000 ; ///< maximal number of textures
-  uint32_t const static maxBuffers  = 100  ; ///< maximal number of buffers
-  uint32_t const static maxPrograms = 100  ; ///< maximal number of programs
-  Buffer  buffers [maxBuffers ]; ///< array of all buffers
-  Texture textures[maxTextures]; ///< array of all textures
-  Uniform uniforms[maxUniforms]; ///< array of all uniform variables
-  Program programs[maxPrograms]; ///< array of all programs
-  Frame   framebuffer;           ///< framebuffer - output of rendering
+  ResourceTable<Buffer > buffers ; ///< table of all buffers
+  ResourceTable<Texture> textures; ///< table of all textures
+  ResourceTable<Uniform> uniforms; ///< table of all uniform variables
+  ResourceTable<Program> programs; ///< table of all programs
+  ResourceTable<UniformBuffer> uniformBuffers; ///< table of all uniform buffers
+  ResourceTable<uint64_t> queries; ///< results of occlusion queries (number of samples that passed depth test)
+  ResourceTable<Frame  > frames  ; ///< render targets that can be bound by bind framebuffer command
+  Frame   framebuffer;             ///< framebuffer - output of rendering
 };
 //! [GPUMemory]
 
@@ -271,9 +684,24 @@ struct ClearCommand{
   float       depth      = 1e10        ; ///< depth buffer will be cleared by this value
   bool        clearColor = true        ; ///< is color cleaning enabled?
   bool        clearDepth = true        ; ///< is depth cleaning enabled?
+  bool        fast       = false       ; ///< tiles are only marked as cleared, they are filled on first touch or by gpu_resolve
 };
 //! [ClearCommand]
 
+/**
+ * @brief This enum represents how fragment color (src) is blended with framebuffer color (dst).
+ * a is alpha of the fragment.
+ */
+//! [BlendMode]
+enum class BlendMode{
+  ALPHA        , ///< src * a + dst * (1 - a), fragments with a <= 0.5 do not write depth
+  OFF          , ///< src, framebuffer is not read, fragments always write depth
+  ADDITIVE     , ///< src * a + dst
+  PREMULTIPLIED, ///< src + dst * (1 - a), color of src is already multiplied by a
+  WEIGHTED     , ///< weighted blended order independent transparency, fragments do not write depth and their order does not matter
+};
+//! [BlendMode]
+
 /**
  * @brief This structure represents draw command.
  * Draw command issues draw operation on the GPU.
@@ -282,11 +710,74 @@ struct ClearCommand{
 struct DrawCommand{
   int32_t     programID       = -1   ; ///< selected shader program - id
   uint32_t    nofVertices     = 0    ; ///< number of vertices to draw
+  uint32_t    nofInstances    = 1    ; ///< number of instances to draw
   bool        backfaceCulling = false; ///< is culling of backfacing triangles enabled?
+  Topology    topology        = Topology::TRIANGLES; ///< how vertices are assembled into triangles
+  bool        depthOnly       = false; ///< only depth is written, fragment shader is not executed
+  bool        opaque          = false; ///< all fragments are opaque (alpha > 0.5), the draw takes part in Z-prepass
+  BlendMode   blendMode       = BlendMode::ALPHA; ///< how fragment colors are blended into framebuffer
+  int32_t     uniformBufferID = -1   ; ///< id of uniform buffer or -1 (no uniform block)
+  uint32_t    uniformBlock    = 0    ; ///< index of block in uniform buffer that is bound to the draw
   VertexArray vao                    ; ///< active vertex array (input/ triangles)
 };
 //! [DrawCommand]
 
+/**
+ * @brief This structure represents one draw of multi draw command.
+ * Draw records are stored in a buffer in GPU memory.
+ */
+//! [DrawRecord]
+struct DrawRecord{
+  uint32_t nofVertices  = 0; ///< number of vertices to draw
+  uint32_t nofInstances = 1; ///< number of instances to draw
+  uint64_t indexOffset  = 0; ///< offset of indices in bytes, it is added to vao.indexOffset
+  int32_t  baseVertex   = 0; ///< value added to every vertex id (first vertex of non-indexed draw)
+  uint32_t drawID       = 0; ///< draw id that is passed to shaders (gl_DrawID)
+};
+//! [DrawRecord]
+
+/**
+ * @brief This structure represents multi draw command.
+ * Multi draw command issues several draws that share program and vertex array.
+ * Parameters of the draws are read from a buffer of DrawRecords.
+ */
+//! [MultiDrawCommand]
+struct MultiDrawCommand{
+  int32_t     programID       = -1   ; ///< selected shader program - id
+  int32_t     drawBufferID    = -1   ; ///< id of buffer with draw records
+  uint64_t    drawOffset      = 0    ; ///< offset of the first draw record in bytes
+  uint32_t    nofDraws        = 0    ; ///< number of draw records
+  bool        backfaceCulling = false; ///< is culling of backfacing triangles enabled?
+  Topology    topology        = Topology::TRIANGLES; ///< how vertices are assembled into triangles
+  bool        depthOnly       = false; ///< only depth is written, fragment shader is not executed
+  bool        opaque          = false; ///< all fragments are opaque (alpha > 0.5), the draws take part in Z-prepass
+  BlendMode   blendMode       = BlendMode::ALPHA; ///< how fragment colors are blended into framebuffer
+  int32_t     uniformBufferID = -1   ; ///< id of uniform buffer or -1, every draw binds block DrawRecord::drawID
+  VertexArray vao                    ; ///< active vertex array (input/ triangles)
+};
+//! [MultiDrawCommand]
+
+/**
+ * @brief This structure represents begin query command.
+ * Samples that pass depth test between begin query and end query commands are counted to GPUMemory::queries[queryID].
+ */
+//! [QueryCommand]
+struct QueryCommand{
+  uint32_t queryID = 0; ///< index of query result in GPUMemory::queries
+};
+//! [QueryCommand]
+
+/**
+ * @brief This structure represents bind framebuffer command.
+ * Following commands render to the bound frame. The previously bound frame is resolved (gpu_resolve),
+ * so following commands can read it as a texture (frameColorTexture, frameDepthTexture, frameAttachmentTexture).
+ */
+//! [BindFramebufferCommand]
+struct BindFramebufferCommand{
+  int32_t frameID = -1; ///< index of frame in GPUMemory::frames, -1 binds GPUMemory::framebuffer
+};
+//! [BindFramebufferCommand]
+
 /**
  * @brief This enum represents type of command.
  */
@@ -295,6 +786,10 @@ enum class CommandType{
   EMPTY, ///< empty command
   CLEAR, ///< clear command
   DRAW , ///< draw command
+  MULTI_DRAW, ///< multi draw command
+  BEGIN_QUERY, ///< begin of occlusion query
+  END_QUERY  , ///< end of occlusion query
+  BIND_FRAMEBUFFER, ///< binds render target for the following commands
 };
 //! [CommandType]
 
@@ -306,6 +801,9 @@ union CommandData{
   CommandData():drawCommand(){}///< constructor
   ClearCommand clearCommand;   ///< clear command data
   DrawCommand  drawCommand ;   ///< draw command data
+  MultiDrawCommand multiDrawCommand; ///< multi draw command data
+  QueryCommand queryCommand;   ///< begin query command data
+  BindFramebufferCommand bindFramebufferCommand; ///< bind framebuffer command data
 };
 //! [CommandData]
 
@@ -319,6 +817,61 @@ struct Command{
 };
 //! [Command]
 
+/**
+ * @brief This class represents storage of commands.
+ * Commands are stored in chunks that are allocated on demand.
+ * Writing to a command behind the allocated chunks allocates new chunks.
+ * Chunks are never moved or freed, so references to commands stay valid.
+ */
+//! [CommandStorage]
+class CommandStorage{
+  public:
+    uint32_t static constexpr chunkSize = 256; ///< number of commands in one chunk
+    /**
+     * @brief This function returns command, the storage grows if it is needed
+     *
+     * @param i index of command
+     *
+     * @return command
+     */
+    Command&operator[](size_t i){
+      while(i >= capacity())chunks.emplace_back(chunkSize);
+      return chunks[i/chunkSize][i%chunkSize];
+    }
+    /**
+     * @brief This function returns command, commands behind the storage are empty
+     *
+     * @param i index of command
+     *
+     * @return command
+     */
+    Command const&operator[](size_t i)const{
+      static Command const empty;
+      if(i >= capacity())return empty;
+      return chunks[i/chunkSize][i%chunkSize];
+    }
+    /**
+     * @brief This function returns number of allocated commands
+     *
+     * @return number of allocated commands
+     */
+    size_t capacity()const{return chunks.size()*chunkSize;}
+  private:
+    std::vector<std::vector<Command>>chunks;///< chunks of commands
+};
+//! [CommandStorage]
+
+/**
+ * @brief This enum represents how command buffer is executed.
+ */
+//! [ExecutionMode]
+enum class ExecutionMode{
+  FORWARD          , ///< commands are executed in order
+  Z_PREPASS        , ///< depth of opaque draws is written first, then only visible fragments of opaque draws are shaded
+  VISIBILITY_BUFFER, ///< opaque draws write visible triangle of every pixel, fragment shader is then run once per pixel
+};
+//! [ExecutionMode]
+
 /**
  * @brief This struct represents a command buffer.
  * Command buffer is used for CPU -> GPU communication.
@@ -326,9 +879,16 @@ struct Command{
  */
 //! [CommandBuffer]
 struct CommandBuffer{
-  uint32_t static const maxCommands           = 10000; ///< maximal number of commands
-  uint32_t              nofCommands           = 0    ; ///< number of used commands in command buffer
-  Command               commands[maxCommands]        ; ///< array of commands
+  uint32_t       nofCommands = 0; ///< number of used commands in command buffer
+  CommandStorage commands       ; ///< commands, the storage grows on demand
+  ExecutionMode  executionMode = ExecutionMode::FORWARD; ///< how commands are executed
+  /**
+   * @brief This function removes all commands, allocated memory is kept for next frame
+   */
+  void reset(){
+    for(uint32_t i=0;i<nofCommands;++i)commands[i] = Command();
+    nofCommands = 0;
+  }
 };
 //! [CommandBuffer]
 
@@ -340,13 +900,15 @@ struct CommandBuffer{
  * @param depth depth for cleaning
  * @param clearColor should the color buffer be cleaned?
  * @param clearDepth should the depth buffer be cleaned?
+ * @param fast should tiles only be marked as cleared (fast clear)?
  */
 inline void pushClearCommand(
     CommandBuffer      &cb                       ,
     glm::vec4     const&color      = glm::vec4(0),
     float               depth      = 10e10       ,
     bool                clearColor = true        ,
-    bool                clearDepth = true        ){
+    bool                clearDepth = true        ,
+    bool                fast       = false       ){
   auto&cmd=cb.commands[cb.nofCommands];
   cmd.type = CommandType::CLEAR;
   auto&c = cmd.data.clearCommand;
@@ -354,6 +916,49 @@ inline void pushClearCommand(
   c.depth      = depth     ;
   c.clearColor = clearColor;
   c.clearDepth = clearDepth;
+  c.fast       = fast      ;
+  cb.nofCommands++;
+}
+
+/**
+ * @brief This function can be used to insert begin of occlusion query to command buffer.
+ *
+ * @param cb command buffer
+ * @param queryID index of query result in GPUMemory::queries
+ */
+inline void pushBeginQueryCommand(
+    CommandBuffer      &cb     ,
+    uint32_t            queryID){
+  auto&cmd=cb.commands[cb.nofCommands];
+  cmd.type = CommandType::BEGIN_QUERY;
+  cmd.data.queryCommand.queryID = queryID;
+  cb.nofCommands++;
+}
+
+/**
+ * @brief This function can be used to insert end of occlusion query to command buffer.
+ *
+ * @param cb command buffer
+ */
+inline void pushEndQueryCommand(
+    CommandBuffer      &cb     ){
+  auto&cmd=cb.commands[cb.nofCommands];
+  cmd.type = CommandType::END_QUERY;
+  cb.nofCommands++;
+}
+
+/**
+ * @brief This function can be used to insert bind framebuffer command to command buffer.
+ *
+ * @param cb command buffer
+ * @param frameID index of frame in GPUMemory::frames, -1 binds GPUMemory::framebuffer
+ */
+inline void pushBindFramebufferCommand(
+    CommandBuffer      &cb          ,
+    int32_t             frameID = -1){
+  auto&cmd=cb.commands[cb.nofCommands];
+  cmd.type = CommandType::BIND_FRAMEBUFFER;
+  cmd.data.bindFramebufferCommand.frameID = frameID;
   cb.nofCommands++;
 }
 
@@ -365,19 +970,68 @@ inline void pushClearCommand(
  * @param prg index of program that should be used for rendering
  * @param vao vertex array
  * @param backfaceCulling should the backface culling be enabled?
+ * @param nofInstances number of instances that should be rendered
+ * @param topology how vertices are assembled into triangles
+ * @param uniformBufferID id of uniform buffer or -1
+ * @param uniformBlock index of block in uniform buffer
  */
 inline void pushDrawCommand(
     CommandBuffer      &cb                     ,
     uint32_t            nofVertices            , 
     int32_t             prg             = 0    ,
     VertexArray   const&vao             = {}   ,
-    bool                backfaceCulling = false){
+    bool                backfaceCulling = false,
+    uint32_t            nofInstances    = 1    ,
+    Topology            topology        = Topology::TRIANGLES,
+    int32_t             uniformBufferID = -1   ,
+    uint32_t            uniformBlock    = 0    ){
   auto&cmd=cb.commands[cb.nofCommands];
   cmd.type = CommandType::DRAW;
   auto&c = cmd.data.drawCommand;
   c.backfaceCulling = backfaceCulling;
   c.nofVertices     = nofVertices    ;
+  c.nofInstances    = nofInstances   ;
+  c.topology        = topology       ;
+  c.programID       = prg            ;
+  c.uniformBufferID = uniformBufferID;
+  c.uniformBlock    = uniformBlock   ;
+  c.vao             = vao            ;
+  cb.nofCommands++;
+}
+
+/**
+ * @brief This function can be used to insert multi draw command into command buffer.
+ *
+ * @param cb command buffer
+ * @param drawBufferID id of buffer that contains DrawRecords
+ * @param nofDraws number of draw records
+ * @param prg index of program that should be used for rendering
+ * @param vao vertex array
+ * @param backfaceCulling should the backface culling be enabled?
+ * @param drawOffset offset of the first draw record in bytes
+ * @param topology how vertices are assembled into triangles
+ * @param uniformBufferID id of uniform buffer or -1, draw binds block with its drawID
+ */
+inline void pushMultiDrawCommand(
+    CommandBuffer      &cb                     ,
+    int32_t             drawBufferID           ,
+    uint32_t            nofDraws               ,
+    int32_t             prg             = 0    ,
+    VertexArray   const&vao             = {}   ,
+    bool                backfaceCulling = false,
+    uint64_t            drawOffset      = 0    ,
+    Topology            topology        = Topology::TRIANGLES,
+    int32_t             uniformBufferID = -1   ){
+  auto&cmd=cb.commands[cb.nofCommands];
+  cmd.type = CommandType::MULTI_DRAW;
+  auto&c = cmd.data.multiDrawCommand;
+  c.backfaceCulling = backfaceCulling;
+  c.drawBufferID    = drawBufferID   ;
+  c.drawOffset      = drawOffset     ;
+  c.topology        = topology       ;
+  c.nofDraws        = nofDraws       ;
   c.programID       = prg            ;
+  c.uniformBufferID = uniformBufferID;
   c.vao             = vao            ;
   cb.nofCommands++;
 }
@@ -399,6 +1053,7 @@ struct Mesh{
   glm::vec4    diffuseColor   = glm::vec4(1.f)   ;///< default diffuseColor (if there is no texture)
   int          diffuseTexture = -1               ;///< diffuse texture or -1 (no texture)
   bool         doubleSided    = false            ;///< double sided material
+  bool         opaque         = false            ;///< opaque material (glTF alphaMode OPAQUE)
 };
 //! [Mesh]
 
@@ -7,48 +7,390 @@
 
 #include <student/gpu.hpp>
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GPU_SSE2
+#endif
+
 struct Triangle {
     OutVertex vertices[3];
 };
 
+// How fragments of a draw are processed
+enum class FragmentMode {
+    NONE,        // draw is skipped
+    SHADE,       // depth test, fragment shader, depth and color write
+    DEPTH_ONLY,  // depth test and depth write, fragment shader is not executed
+    DEPTH_EQUAL, // only fragments with depth equal to the stored depth are shaded (after Z-prepass)
+    VISIBILITY,  // depth test, depth and visibility write, fragment shader is executed later by resolve
+};
+
+// Pass of command buffer execution
+enum class Pass {
+    FORWARD,       // commands are executed in order
+    DEPTH_PREPASS, // only depth of opaque draws is written
+    SHADING,       // draws are shaded against depth from prepass
+    VISIBILITY,    // opaque draws write depth and visibility buffer
+    TRANSLUCENT,   // draws that are not opaque are shaded after visibility buffer resolve
+};
+
+struct VisibilityBuffer;
+struct WeightedBlendBuffer;
+
+// Pipeline state of a draw command, it is set up once and shared by all draws of the command
+struct Pipeline {
+    Program const *prg = nullptr;
+    VertexArray const *vao = nullptr;
+    ShaderInterface si;
+    bool backfaceCulling = false;
+    Topology topology = Topology::TRIANGLES;
+    FragmentMode fragmentMode = FragmentMode::SHADE;
+    BlendMode blendMode = BlendMode::ALPHA;
+    // Visibility buffer of the pass and index of the draw in it
+    VisibilityBuffer *visibility = nullptr;
+    uint32_t visibilityDraw = 0;
+    // Result of active occlusion query or nullptr
+    uint64_t *samplesPassed = nullptr;
+    // Accumulation of weighted blended fragments of the frame
+    WeightedBlendBuffer *weighted = nullptr;
+    // Scratch block filled by program prologue, it is exposed to shaders as si.constants
+    Uniform constants[maxConstants];
+};
+
+// Draw recorded in visibility buffer, the pipeline state is kept for the resolve
+struct VisibilityDraw {
+    Pipeline pipeline;
+    std::vector<Triangle> triangles;
+};
+
+// Visibility buffer stores visible triangle of every pixel as packed (draw, primitive) pair
+struct VisibilityBuffer {
+    static constexpr uint64_t empty = ~uint64_t(0);
+    std::vector<uint64_t> ids;
+    std::vector<VisibilityDraw> draws;
+};
+
+// Weighted blended order independent transparency, one value per sample:
+// sum of colors weighted by alpha and depth (sum of weights in alpha) and revealage - product of (1 - alpha)
+struct WeightedBlendBuffer {
+    std::vector<glm::vec4> accumulation;
+    std::vector<float> revealage;
+};
+
+uint64_t packVisibility(uint32_t draw, uint32_t primitive) {
+    return static_cast<uint64_t>(draw) << 32 | primitive;
+}
+
+// Number of hierarchical depth tiles in a row and in a column
+uint32_t hiZWidth(Frame const &frame) {
+    return (frame.width + hiZTileSize - 1) / hiZTileSize;
+}
+
+uint32_t hiZHeight(Frame const &frame) {
+    return (frame.height + hiZTileSize - 1) / hiZTileSize;
+}
+
+// Index of a pixel in color and depth buffers
+size_t pixelIndex(Frame const &frame, uint32_t x, uint32_t y) {
+    return layoutIndex(frame.layout, frame.width, x, y);
+}
+
+// Number of pixels stored in color and depth buffers, tiled frames are padded to whole tiles
+size_t frameSize(Frame const &frame) {
+    if (frame.layout == FrameLayout::TILED) {
+        return static_cast<size_t>(hiZWidth(frame)) * hiZHeight(frame) * hiZTileSize * hiZTileSize;
+    }
+    return static_cast<size_t>(frame.width) * frame.height;
+}
+
+// Quantizes depth to the integer depth format of the frame, float depth is not quantized
+uint32_t quantizeDepth(DepthFormat format, float z) {
+    switch (format) {
+        case DepthFormat::UNORM16:
+            return static_cast<uint32_t>(glm::clamp(z, 0.f, 1.f) * 65535.f + .5f);
+        case DepthFormat::UNORM24:
+            return static_cast<uint32_t>(glm::clamp(z, 0.f, 1.f) * 16777215.f + .5f);
+        default:
+            return 0;
+    }
+}
+
+// Reads stored integer depth, 16-bit depth uses 2 bytes per pixel and 24-bit depth uses low bits of a 32-bit word
+uint32_t loadUnormDepth(Frame const &frame, size_t index) {
+    uint8_t const *data = reinterpret_cast<uint8_t const *>(frame.depth);
+    if (frame.depthFormat == DepthFormat::UNORM16) {
+        uint16_t value;
+        std::memcpy(&value, data + index * sizeof(value), sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    std::memcpy(&value, data + index * sizeof(value), sizeof(value));
+    return value;
+}
+
+// Compares fragment depth with stored depth, it is negative if the fragment is nearer and zero if they are equal
+// Integer formats compare depth quantized by quantizeDepth
+int compareDepth(Frame const &frame, size_t index, float z, uint32_t quantized) {
+    if (frame.depthFormat == DepthFormat::FLOAT32) {
+        return z < frame.depth[index] ? -1 : z == frame.depth[index] ? 0 : 1;
+    }
+    uint32_t stored = loadUnormDepth(frame, index);
+    return quantized < stored ? -1 : quantized > stored;
+}
+
+void storeDepth(Frame &frame, size_t index, float z, uint32_t quantized) {
+    uint8_t *data = reinterpret_cast<uint8_t *>(frame.depth);
+    switch (frame.depthFormat) {
+        case DepthFormat::FLOAT32:
+            frame.depth[index] = z;
+            break;
+        case DepthFormat::UNORM16: {
+            uint16_t value = static_cast<uint16_t>(quantized);
+            std::memcpy(data + index * sizeof(value), &value, sizeof(value));
+            break;
+        }
+        case DepthFormat::UNORM24:
+            std::memcpy(data + index * sizeof(quantized), &quantized, sizeof(quantized));
+            break;
+    }
+}
+
+// Stored depth converted to float
+float loadDepth(Frame const &frame, size_t index) {
+    switch (frame.depthFormat) {
+        case DepthFormat::UNORM16:
+            return loadUnormDepth(frame, index) / 65535.f;
+        case DepthFormat::UNORM24:
+            return loadUnormDepth(frame, index) / 16777215.f;
+        default:
+            return frame.depth[index];
+    }
+}
+
+// Stores depth of a sample that passed depth test with the comparison result of compareDepth,
+// returns the overwritten depth if the stored depth got nearer, otherwise -infinity,
+// the overwritten depth is only needed for tile max depth, so frames without hiZ do not read it
+float replaceDepth(Frame &frame, size_t index, float z, uint32_t quantized, int comparison) {
+    float previous = comparison < 0 && frame.hiZ ? loadDepth(frame, index) : -std::numeric_limits<float>::infinity();
+    storeDepth(frame, index, z, quantized);
+    return previous;
+}
+
+// Tile is hidden if the nearest depth of a triangle is behind max depth of the tile, in integer formats after quantization
+bool hiddenByHiZ(Frame const &frame, float minZ, float tileDepth) {
+    if (frame.depthFormat == DepthFormat::FLOAT32) {
+        return minZ > tileDepth;
+    }
+    return quantizeDepth(frame.depthFormat, minZ) > quantizeDepth(frame.depthFormat, tileDepth);
+}
+
+// Recomputes max depth of a tile, depth only decreases so the old max is always conservative and this tightens it
+void updateHiZTile(Frame &frame, uint32_t tileX, uint32_t tileY) {
+    uint32_t endX = std::min((tileX + 1) * hiZTileSize, frame.width);
+    uint32_t endY = std::min((tileY + 1) * hiZTileSize, frame.height);
+    float maxDepth = -std::numeric_limits<float>::infinity();
+    for (uint32_t y = tileY * hiZTileSize; y < endY; ++y) {
+        for (uint32_t x = tileX * hiZTileSize; x < endX; ++x) {
+            for (uint32_t s = 0; s < frame.samples; ++s) {
+                maxDepth = std::max(maxDepth, loadDepth(frame, pixelIndex(frame, x, y) * frame.samples + s));
+            }
+        }
+    }
+    frame.hiZ[tileX + tileY * hiZWidth(frame)] = maxDepth;
+}
+
+// Color target pixels are packed RGBA8 words, red is the lowest byte
+uint32_t loadPixel(uint8_t const *pixel) {
+    uint32_t packed;
+    std::memcpy(&packed, pixel, sizeof(packed));
+    return packed;
+}
+
+void storePixel(uint8_t *pixel, uint32_t packed) {
+    std::memcpy(pixel, &packed, sizeof(packed));
+}
+
+// Converts color to a packed RGBA8 pixel, channels are clamped to [0, 1] and truncated like (uint8_t)(c * 255.f)
+uint32_t packColor(glm::vec4 color) {
+#ifdef GPU_SSE2
+    __m128 c = _mm_loadu_ps(&color[0]);
+    c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    __m128i i = _mm_cvttps_epi32(_mm_mul_ps(c, _mm_set1_ps(255.f)));
+    i = _mm_packs_epi32(i, i);
+    i = _mm_packus_epi16(i, i);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(i));
+#else
+    color = glm::clamp(color, 0.f, 1.f) * 255.f;
+    return static_cast<uint32_t>(color.r) | static_cast<uint32_t>(color.g) << 8 |
+           static_cast<uint32_t>(color.b) << 16 | static_cast<uint32_t>(color.a) << 24;
+#endif
+}
+
+// Writes color to a pixel of additional color attachment in its format
+void storeAttachment(ColorAttachment const &attachment, size_t index, glm::vec4 color) {
+    uint8_t *pixel = static_cast<uint8_t *>(attachment.data) + index * colorFormatSize(attachment.format);
+    switch (attachment.format) {
+        case ColorFormat::RGBA8:
+            storePixel(pixel, packColor(color));
+            break;
+        case ColorFormat::RGBA16F: {
+            uint64_t packed = glm::packHalf4x16(color);
+            std::memcpy(pixel, &packed, sizeof(packed));
+            break;
+        }
+        case ColorFormat::RGBA32F:
+            std::memcpy(pixel, &color[0], sizeof(color));
+            break;
+    }
+}
+
+// Clears of at least this many words use non-temporal stores, smaller buffers stay in cache for drawing
+size_t const streamingClearSize = size_t(1) << 18;
+
+// Fills count 32-bit words, aligned part of large fills bypasses the cache
+void fillWords(uint8_t *dst, size_t count, uint32_t value) {
+    size_t i = 0;
+#ifdef GPU_SSE2
+    if (count >= streamingClearSize && reinterpret_cast<uintptr_t>(dst) % sizeof(uint32_t) == 0) {
+        for (; i < count && reinterpret_cast<uintptr_t>(dst + i * 4) % sizeof(__m128i) != 0; ++i) {
+            std::memcpy(dst + i * 4, &value, sizeof(value));
+        }
+        __m128i wide = _mm_set1_epi32(static_cast<int>(value));
+        for (; i + 4 <= count; i += 4) {
+            _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i * 4), wide);
+        }
+        _mm_sfence();
+    }
+#endif
+    for (; i < count; ++i) {
+        std::memcpy(dst + i * 4, &value, sizeof(value));
+    }
+}
+
+// Fills count pixels of depth buffer starting at pixel begin by depth in the format of the frame
+void fillDepth(Frame &frame, size_t begin, size_t count, float depth) {
+    uint8_t *data = reinterpret_cast<uint8_t *>(frame.depth);
+    uint32_t quantized = quantizeDepth(frame.depthFormat, depth);
+
+    if (frame.depthFormat == DepthFormat::FLOAT32) {
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        fillWords(data + begin * 4, count, bits);
+        return;
+    }
+    if (frame.depthFormat == DepthFormat::UNORM24) {
+        fillWords(data + begin * 4, count, quantized);
+        return;
+    }
+
+    // 16-bit depth is filled two pixels per word, pixels at odd ends are stored alone
+    if (begin % 2 && count) {
+        storeDepth(frame, begin++, depth, quantized);
+        --count;
+    }
+    fillWords(data + begin * 2, count / 2, quantized | quantized << 16);
+    if (count % 2) {
+        storeDepth(frame, begin + count - 1, depth, quantized);
+    }
+}
+
+// Pending fast clear of a tile
+uint8_t const pendingColor = 1;
+uint8_t const pendingDepth = 2;
+
+// Fills a tile by pending fast clear values on its first touch
+void materializeTile(Frame &frame, uint32_t tileX, uint32_t tileY) {
+    uint8_t &pending = frame.fastClear->tiles[tileX + tileY * hiZWidth(frame)];
+    if (!pending) {
+        return;
+    }
+
+    uint32_t beginX = tileX * hiZTileSize;
+    uint32_t width = std::min(beginX + hiZTileSize, frame.width) - beginX;
+    uint32_t endY = std::min((tileY + 1) * hiZTileSize, frame.height);
+    // Tile of a tiled frame is one block including its padding
+    if (frame.layout == FrameLayout::TILED) {
+        width = hiZTileSize * hiZTileSize;
+        endY = tileY * hiZTileSize + 1;
+    }
+    // Samples of a pixel are stored together, so samples of a row are contiguous too
+    width *= frame.samples;
+    for (uint32_t y = tileY * hiZTileSize; y < endY; ++y) {
+        size_t row = pixelIndex(frame, beginX, y) * frame.samples;
+        if (pending & pendingColor) {
+            fillWords(frame.color + row * 4, width, frame.fastClear->color);
+        }
+        if (pending & pendingDepth) {
+            fillDepth(frame, row, width, frame.fastClear->depth);
+        }
+    }
+    pending = 0;
+}
+
 // Clears the GPU memory framebuffer
 void clear(GPUMemory &mem, ClearCommand cmd) {
+    Frame &frame = mem.framebuffer;
+    size_t pixels = frameSize(frame) * frame.samples;
+    size_t tiles = static_cast<size_t>(hiZWidth(frame)) * hiZHeight(frame);
+    uint8_t cleared = (cmd.clearColor ? pendingColor : 0) | (cmd.clearDepth ? pendingDepth : 0);
+    bool fast = cmd.fast && frame.fastClear && frame.fastClear->tiles;
+
     if (cmd.clearColor) {
-        // Iterates over every pixel in the framebuffer and sets its colour
-        for (uint32_t i = 0; i < mem.framebuffer.width * mem.framebuffer.height; ++i) {
-            float red = cmd.color.r;
-            mem.framebuffer.color[i*4+0] = (uint8_t) (red * 255.f);
-            float green = cmd.color.g;
-            mem.framebuffer.color[i*4+1] = (uint8_t) (green * 255.f);
-            float blue = cmd.color.b;
-            mem.framebuffer.color[i*4+2] = (uint8_t) (blue * 255.f);
-            float alpha = cmd.color.a;
-            mem.framebuffer.color[i*4+3] = (uint8_t) (alpha * 255.f);
+        // Clear color is converted once and stored as whole pixels
+        uint32_t packed = packColor(cmd.color);
+        if (fast) {
+            frame.fastClear->color = packed;
+        } else {
+            fillWords(frame.color, pixels, packed);
+        }
+        // Additional color attachments are always cleared immediately
+        for (auto const &attachment : frame.attachments) {
+            for (size_t i = 0; attachment.data && i < frameSize(frame); ++i) {
+                storeAttachment(attachment, i, cmd.color);
+            }
         }
     }
 
     if (cmd.clearDepth) {
-        float depth = cmd.depth;
-        // Iterates over every pixel in the framebuffer and sets its depth
-        for (uint32_t i = 0; i < mem.framebuffer.width * mem.framebuffer.height; ++i) {
-            mem.framebuffer.depth[i] = depth;
+        if (fast) {
+            frame.fastClear->depth = cmd.depth;
+        } else {
+            fillDepth(frame, 0, pixels, cmd.depth);
+        }
+        // Every tile has the cleared depth as its max depth
+        if (frame.hiZ) {
+            std::fill(frame.hiZ, frame.hiZ + tiles, cmd.depth);
+        }
+    }
+
+    // Fast clear marks every tile, normal clear overrides pending clear of the cleared buffers
+    if (frame.fastClear && frame.fastClear->tiles) {
+        for (size_t i = 0; i < tiles; ++i) {
+            frame.fastClear->tiles[i] = fast ? frame.fastClear->tiles[i] | cleared : frame.fastClear->tiles[i] & ~cleared;
         }
     }
 }
 
-// Computes vertex ID
-void computeVertexID(GPUMemory &mem, DrawCommand cmd, InVertex &inVertex, uint32_t i) {
-    // If indexBufferID is equal to -1, the vertex is not indexed and sets the vertex id based on a for loop in calling function
-    if (cmd.vao.indexBufferID == -1) {
-        inVertex.gl_VertexID = i;
-        return;
+// Reads i-th index of a draw
+uint32_t fetchIndex(GPUMemory &mem, VertexArray const &vao, DrawRecord const &draw, uint32_t i) {
+    // If indexBufferID is equal to -1, the vertex is not indexed and the index is the number of the vertex
+    if (vao.indexBufferID == -1) {
+        return i;
     }
 
     // Gets the vertex ID from the index buffer data
-    const uint8_t* idData = static_cast<const uint8_t*>(mem.buffers[cmd.vao.indexBufferID].data) + cmd.vao.indexOffset;
+    const uint8_t* idData = static_cast<const uint8_t*>(std::as_const(mem).buffers[vao.indexBufferID].data) + vao.indexOffset + draw.indexOffset;
 
-    uint32_t index;
-    switch (cmd.vao.indexType) {
+    uint32_t index = 0;
+    switch (vao.indexType) {
         case IndexType::UINT8:
             index = idData[i];
             break;
@@ -60,24 +402,73 @@ void computeVertexID(GPUMemory &mem, DrawCommand cmd, InVertex &inVertex, uint32
             break;
     }
 
-    // Sets the vertex ID to the correct value
-    inVertex.gl_VertexID = index;
+    return index;
+}
+
+// Returns index value that restarts strip or fan, it has all bits set
+uint32_t restartIndex(IndexType type) {
+    switch (type) {
+        case IndexType::UINT8:
+            return 0xffu;
+        case IndexType::UINT16:
+            return 0xffffu;
+        default:
+            return 0xffffffffu;
+    }
+}
+
+// Computes vertex ID
+void computeVertexID(GPUMemory &mem, VertexArray const &vao, DrawRecord const &draw, InVertex &inVertex, uint32_t i) {
+    inVertex.gl_VertexID = fetchIndex(mem, vao, draw, i) + draw.baseVertex;
+}
+
+// Decodes one component of packed (half float or normalized integer) attribute
+float decodeComponent(const uint8_t *value, AttributeType type, uint32_t component) {
+    switch ((uint32_t)type >> 4) {
+        case 1:
+            return glm::unpackHalf1x16(reinterpret_cast<const uint16_t*>(value)[component]);
+        case 2:
+            return glm::unpackUnorm1x8(value[component]);
+        case 3:
+            return glm::unpackSnorm1x8(value[component]);
+        case 4:
+            return glm::unpackUnorm1x16(reinterpret_cast<const uint16_t*>(value)[component]);
+        case 5:
+            return glm::unpackSnorm1x16(reinterpret_cast<const uint16_t*>(value)[component]);
+    }
+    return 0.f;
+}
+
+// Decodes packed attribute into floats, missing components keep their default value
+void decodeAttribute(Attribute &attribute, const uint8_t *value, AttributeType type) {
+    for (uint32_t c = 0; c < attributeComponents(type); ++c) {
+        attribute.v4[c] = decodeComponent(value, type, c);
+    }
 }
 
 // Reads vertex attributes and binds them to inVertex attributes
-void readAttributes(InVertex &inVertex, GPUMemory &mem, DrawCommand cmd) {
+void readAttributes(InVertex &inVertex, GPUMemory &mem, VertexArray const &vao) {
     uint64_t i = 0; // attribute index
     // Itterate over every attribute
-    for (auto attr : cmd.vao.vertexAttrib) {
+    for (auto const &attr : vao.vertexAttrib) {
+        // Unused attributes have no buffer bound
+        if (attr.type == AttributeType::EMPTY) {
+            ++i;
+            continue;
+        }
+
         uint64_t offset = attr.offset;
         uint64_t stride = attr.stride;
         uint64_t bufferID = attr.bufferID;
         AttributeType type = attr.type;
 
+        // Per-instance attributes advance every divisor instances instead of every vertex
+        uint64_t element = attr.divisor ? inVertex.gl_InstanceID / attr.divisor : inVertex.gl_VertexID;
+
         // Calculate the index of the vertex in the buffer
-        uint64_t index = offset + stride * inVertex.gl_VertexID;
+        uint64_t index = offset + stride * element;
         // Get a pointer to the memory location of the attribute data
-        auto value = (uint8_t*)mem.buffers[bufferID].data + index;
+        auto value = (uint8_t*)std::as_const(mem).buffers[bufferID].data + index;
 
         // Stores the attribute in the appropriate variable in vertex
         switch (type) {
@@ -105,6 +496,10 @@ void readAttributes(InVertex &inVertex, GPUMemory &mem, DrawCommand cmd) {
             case AttributeType::UVEC4:
                 inVertex.attributes[i].u4 = *((glm::uvec4 *) value);
                 break;
+            default:
+                // Half float and normalized integer attributes are decoded to floats
+                decodeAttribute(inVertex.attributes[i], value, type);
+                break;
         }
         // Increments the attribute index
         ++i;
@@ -112,34 +507,29 @@ void readAttributes(InVertex &inVertex, GPUMemory &mem, DrawCommand cmd) {
 }
 
 // Assigns the vertex ID and attributes to the vertex
-void runVertexAssembly(InVertex &inVertex, GPUMemory &mem, DrawCommand cmd, uint32_t i) {
-    computeVertexID(mem, cmd, inVertex, i);
-    readAttributes(inVertex, mem, cmd);
+void runVertexAssembly(InVertex &inVertex, GPUMemory &mem, Pipeline const &pipeline, DrawRecord const &draw, uint32_t i) {
+    computeVertexID(mem, *pipeline.vao, draw, inVertex, i);
+    readAttributes(inVertex, mem, *pipeline.vao);
 }
 
-// Initializes vertices and assembles triangle from them
-void triangleAssembly(Triangle &triangle, GPUMemory &mem, DrawCommand cmd, uint32_t drawID, uint32_t triangleIndex) {
-    Program prg = mem.programs[cmd.programID];
+// Assembles i-th vertex of a draw and runs vertex shader on it
+void shadeVertex(OutVertex &outVertex, GPUMemory &mem, Pipeline const &pipeline, DrawRecord const &draw, uint32_t instanceID, uint32_t i) {
+    InVertex inVertex;
 
-    // Iterate through every vertex
-    for (int i = 0; i < 3; ++i) {
-        InVertex inVertex;
-        OutVertex outVertex;
-
-        inVertex.gl_DrawID = drawID;
-
-        // Assign the vertex ID and attributes to the vertex
-        runVertexAssembly(inVertex, mem, cmd, triangleIndex * 3 + i);
+    inVertex.gl_DrawID = draw.drawID;
+    inVertex.gl_InstanceID = instanceID;
 
-        // Sets the shader properties
-        ShaderInterface si;
-        si.textures = mem.textures;
-        si.uniforms = mem.uniforms;
+    // Assign the vertex ID and attributes to the vertex
+    runVertexAssembly(inVertex, mem, pipeline, draw, i);
 
-        prg.vertexShader(outVertex, inVertex, si);
+    pipeline.prg->vertexShader(outVertex, inVertex, pipeline.si);
+}
 
-        // Adds the outVertex to the triangle
-        triangle.vertices[i] = outVertex;
+// Initializes vertices and assembles triangle from them
+void triangleAssembly(Triangle &triangle, GPUMemory &mem, Pipeline const &pipeline, DrawRecord const &draw, uint32_t instanceID, uint32_t triangleIndex) {
+    // Iterate through every vertex
+    for (int i = 0; i < 3; ++i) {
+        shadeVertex(triangle.vertices[i], mem, pipeline, draw, instanceID, triangleIndex * 3 + i);
     }
 }
 
@@ -200,70 +590,259 @@ glm::vec3 calculateBarycentric(Triangle &triangle, glm::vec2 point) {
     return glm::vec3(u, v, w);
 }
 
-void rasterizeFragment(GPUMemory &mem, Triangle &triangle, glm::vec3 barycentric, glm::vec2 point, Program &prg) {
+uint32_t const maxSamples = 4;
+
+// Sample positions of 4x multisampling (rotated grid)
+glm::vec2 const samplePositions[maxSamples] = {{0.375f, 0.125f}, {0.875f, 0.375f}, {0.125f, 0.625f}, {0.625f, 0.875f}};
+
+// Samples of a pixel covered by a triangle with their depths, pixel is shaded at its center
+struct Coverage {
+    uint32_t mask = 0;
+    float z[maxSamples];
+    glm::vec3 barycentric;
+};
+
+float interpolateDepth(Triangle const &triangle, glm::vec3 barycentric) {
+    return triangle.vertices[0].gl_Position.z * barycentric.x + triangle.vertices[1].gl_Position.z * barycentric.y + triangle.vertices[2].gl_Position.z * barycentric.z;
+}
+
+// Single sampled pixels are sampled at the center, multisampled pixels at samplePositions
+Coverage pixelCoverage(Triangle &triangle, int x, int y, uint32_t samples) {
+    Coverage coverage;
+    coverage.barycentric = calculateBarycentric(triangle, glm::vec2{x + 0.5f, y + 0.5f});
+    for (uint32_t sample = 0; sample < samples; ++sample) {
+        glm::vec3 barycentric = coverage.barycentric;
+        if (samples > 1) {
+            barycentric = calculateBarycentric(triangle, glm::vec2{x, y} + samplePositions[sample]);
+        }
+        if (barycentric.x < 0.f || barycentric.y < 0.f || barycentric.z < 0.f) {
+            continue;
+        }
+        coverage.mask |= 1u << sample;
+        coverage.z[sample] = interpolateDepth(triangle, barycentric);
+    }
+    return coverage;
+}
+
+// Writes fragment color to a pixel, disabled blending stores one packed pixel without reading the destination
+void blendFragment(uint8_t *pixel, glm::vec4 color, BlendMode mode) {
+    if (mode == BlendMode::OFF) {
+        storePixel(pixel, packColor(color));
+        return;
+    }
+
+    // Alpha blending is clamp(dst / 255 * (1 - a) + src * a, 0, 1) * 255 truncated, in this order of operations,
+    // the fragment color is not clamped before it, the other modes blend clamped colors
+    if (mode != BlendMode::ALPHA) {
+        color = glm::clamp(color, 0.f, 1.f);
+    }
+
+    // Source and destination factors of the blend equation src * srcFactor + dst * dstFactor
+    float srcFactor = color.a;
+    float dstFactor = 1.f - color.a;
+    if (mode == BlendMode::ADDITIVE) {
+        dstFactor = 1.f;
+    }
+    if (mode == BlendMode::PREMULTIPLIED) {
+        srcFactor = 1.f;
+    }
+
+    // All channels are blended at once, alpha of the result is the alpha of the fragment
+    uint32_t dst = loadPixel(pixel);
+#ifdef GPU_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i d = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(dst)), zero), zero);
+    __m128 blended = _mm_add_ps(_mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(255.f)), _mm_set1_ps(dstFactor)),
+                                _mm_mul_ps(_mm_loadu_ps(&color[0]), _mm_set1_ps(srcFactor)));
+    glm::vec4 result;
+    _mm_storeu_ps(&result[0], blended);
+#else
+    glm::vec4 result = glm::vec4(dst & 0xff, dst >> 8 & 0xff, dst >> 16 & 0xff, dst >> 24) / 255.f * dstFactor + color * srcFactor;
+#endif
+    result.a = color.a;
+    storePixel(pixel, packColor(result));
+}
+
+// Weighted blend buffer is allocated for the render target by the first weighted draw
+void prepareWeighted(Frame const &frame, WeightedBlendBuffer &weighted) {
+    if (!weighted.revealage.empty()) {
+        return;
+    }
+    size_t samples = frameSize(frame) * frame.samples;
+    weighted.accumulation.assign(samples, glm::vec4(0.f));
+    weighted.revealage.assign(samples, 1.f);
+}
+
+// Sums and products do not depend on order of fragments, nearer fragments get higher weight (McGuire and Bavoil)
+void accumulateWeighted(WeightedBlendBuffer &weighted, size_t index, glm::vec4 color, float z) {
+    float alpha = glm::clamp(color.a, 0.f, 1.f);
+    float distance = 1.f - glm::clamp(z, 0.f, 1.f);
+    float weight = alpha * glm::clamp(3e3f * distance * distance * distance, 1e-2f, 3e3f);
+    weighted.accumulation[index] += glm::vec4(glm::vec3(color) * weight, weight);
+    weighted.revealage[index] *= 1.f - alpha;
+}
+
+// Weighted average of accumulated fragments is blended over the frame by its coverage 1 - revealage
+void compositeWeighted(Frame &frame, WeightedBlendBuffer &weighted) {
+    if (weighted.revealage.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < weighted.revealage.size(); ++i) {
+        glm::vec4 const &sum = weighted.accumulation[i];
+        if (sum.a <= 0.f) {
+            continue;
+        }
+        float revealage = weighted.revealage[i];
+        uint32_t dst = loadPixel(frame.color + i * 4);
+        glm::vec4 result = glm::vec4(dst & 0xff, dst >> 8 & 0xff, dst >> 16 & 0xff, dst >> 24) / 255.f * revealage;
+        result += glm::vec4(glm::vec3(sum) / sum.a, 1.f) * (1.f - revealage);
+        storePixel(frame.color + i * 4, packColor(result));
+    }
+    weighted.accumulation.clear();
+    weighted.revealage.clear();
+}
+
+// Fragment shader is executed once per pixel, depth test and color write are done for every covered sample
+// Returns the farthest depth overwritten by a nearer one or -infinity, tile max depth changes only if it was overwritten
+float rasterizeFragment(GPUMemory &mem, Triangle &triangle, Coverage const &coverage, glm::vec2 point, Pipeline const &pipeline) {
+    Program const &prg = *pipeline.prg;
+    Frame &frame = mem.framebuffer;
+
     auto a = triangle.vertices[0].gl_Position;
     auto b = triangle.vertices[1].gl_Position;
     auto c = triangle.vertices[2].gl_Position;
+    glm::vec3 barycentric = coverage.barycentric;
 
     InFragment inFragment;
-    inFragment.gl_FragCoord.z = a.z * barycentric.x + b.z * barycentric.y + c.z * barycentric.z;
+    inFragment.gl_FragCoord.z = interpolateDepth(triangle, barycentric);
     inFragment.gl_FragCoord.x = point.x;
     inFragment.gl_FragCoord.y = point.y;
 
-    int index = static_cast<int>(point.x) + static_cast<int>(point.y) * mem.framebuffer.width;
+    size_t pixel = pixelIndex(frame, static_cast<uint32_t>(point.x), static_cast<uint32_t>(point.y));
+    size_t index = pixel * frame.samples;
+    uint32_t quantized[maxSamples];
+    for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+        if (coverage.mask >> sample & 1) {
+            quantized[sample] = quantizeDepth(frame.depthFormat, coverage.z[sample]);
+        }
+    }
+    float overwritten = -std::numeric_limits<float>::infinity();
+
+    // Depth only fragments skip interpolation, fragment shader and color write
+    if (pipeline.fragmentMode == FragmentMode::DEPTH_ONLY) {
+        for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+            int comparison = (coverage.mask >> sample & 1) ? compareDepth(frame, index + sample, coverage.z[sample], quantized[sample]) : 1;
+            if (comparison > 0) {
+                continue;
+            }
+            overwritten = std::max(overwritten, replaceDepth(frame, index + sample, coverage.z[sample], quantized[sample], comparison));
+            if (pipeline.samplesPassed) {
+                ++*pipeline.samplesPassed;
+            }
+            if (pipeline.visibility) {
+                pipeline.visibility->ids[index + sample] = VisibilityBuffer::empty;
+            }
+        }
+        return overwritten;
+    }
+
+    // After Z-prepass only the visible samples of the pixel are shaded
+    uint32_t mask = coverage.mask;
+    if (pipeline.fragmentMode == FragmentMode::DEPTH_EQUAL) {
+        for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+            if ((mask >> sample & 1) && compareDepth(frame, index + sample, coverage.z[sample], quantized[sample]) != 0) {
+                mask &= ~(1u << sample);
+            }
+        }
+        if (!mask) {
+            return overwritten;
+        }
+    }
 
     OutFragment outFragment;
-    ShaderInterface si;
-    si.uniforms = mem.uniforms;
-    si.textures = mem.textures;
 
     float s = barycentric.x / a.w + barycentric.y / b.w + barycentric.z / c.w;
-    float asd1 = barycentric.x / (a.w * s);
     float asd2 = barycentric.y / (b.w * s);
     float asd3 = barycentric.z / (c.w * s);
 
+    // Attributes are interpolated relative to the first vertex, so attributes equal at all vertices stay exact
+    // even though the rounded weights do not sum to exactly one
     auto aAttr = triangle.vertices[0].attributes;
     auto bAttr = triangle.vertices[1].attributes;
     auto cAttr = triangle.vertices[2].attributes;
     for (uint32_t i = 0; i < maxAttributes; ++i) {
         switch (prg.vs2fs[i]) {
             case AttributeType::FLOAT:
-                inFragment.attributes[i].v1 = aAttr[i].v1 * asd1 + bAttr[i].v1 * asd2 + cAttr[i].v1 * asd3;
+                inFragment.attributes[i].v1 = aAttr[i].v1 + (bAttr[i].v1 - aAttr[i].v1) * asd2 + (cAttr[i].v1 - aAttr[i].v1) * asd3;
                 break;
             case AttributeType::VEC2:
-                inFragment.attributes[i].v2 = aAttr[i].v2 * asd1 + bAttr[i].v2 * asd2 + cAttr[i].v2 * asd3;
+                inFragment.attributes[i].v2 = aAttr[i].v2 + (bAttr[i].v2 - aAttr[i].v2) * asd2 + (cAttr[i].v2 - aAttr[i].v2) * asd3;
                 break;
             case AttributeType::VEC3:
-                inFragment.attributes[i].v3 = aAttr[i].v3 * asd1 + bAttr[i].v3 * asd2 + cAttr[i].v3 * asd3;
+                inFragment.attributes[i].v3 = aAttr[i].v3 + (bAttr[i].v3 - aAttr[i].v3) * asd2 + (cAttr[i].v3 - aAttr[i].v3) * asd3;
                 break;
             case AttributeType::VEC4:
-                inFragment.attributes[i].v4 = aAttr[i].v4 * asd1 + bAttr[i].v4 * asd2 + cAttr[i].v4 * asd3;
+                inFragment.attributes[i].v4 = aAttr[i].v4 + (bAttr[i].v4 - aAttr[i].v4) * asd2 + (cAttr[i].v4 - aAttr[i].v4) * asd3;
                 break;
         }
     }
 
-    prg.fragmentShader(outFragment, inFragment, si);
+    prg.fragmentShader(outFragment, inFragment, pipeline.si);
 
-    if (inFragment.gl_FragCoord.z <= mem.framebuffer.depth[index]) {
-        float alpha = outFragment.gl_FragColor.a;
-        if (alpha > 0.5) {
-            mem.framebuffer.depth[index] = inFragment.gl_FragCoord.z;
-        }
+    // Fragments without blending are opaque, blended fragments write depth only if they are opaque enough,
+    // weighted fragments never write depth, so they are independent of order
+    float alpha = outFragment.gl_FragColor.a;
+    bool weighted = pipeline.blendMode == BlendMode::WEIGHTED;
+    bool writesDepth = pipeline.blendMode == BlendMode::OFF || (!weighted && alpha > 0.5);
+    bool passed = false;
 
-        float blend = 1.f - alpha;
+    for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+        int comparison = (mask >> sample & 1) ? compareDepth(frame, index + sample, coverage.z[sample], quantized[sample]) : 1;
+        if (comparison > 0) {
+            continue;
+        }
+        passed = true;
+        if (pipeline.samplesPassed) {
+            ++*pipeline.samplesPassed;
+        }
+        if (writesDepth) {
+            overwritten = std::max(overwritten, replaceDepth(frame, index + sample, coverage.z[sample], quantized[sample], comparison));
+        }
+        if (weighted) {
+            accumulateWeighted(*pipeline.weighted, index + sample, outFragment.gl_FragColor, coverage.z[sample]);
+        } else {
+            blendFragment(frame.color + (index + sample) * 4, outFragment.gl_FragColor, pipeline.blendMode);
+        }
+    }
 
-        uint8_t r = glm::min(mem.framebuffer.color[index * 4 + 0] * blend + outFragment.gl_FragColor.r * alpha + 255.f, 255.f);
-        uint8_t g = glm::min(mem.framebuffer.color[index * 4 + 1] * blend + outFragment.gl_FragColor.g * alpha + 255.f, 255.f);
-        uint8_t b = glm::min(mem.framebuffer.color[index * 4 + 2] * blend + outFragment.gl_FragColor.b * alpha + 255.f, 255.f);
+    // Additional outputs have one value per pixel, they are written if any sample is visible
+    if (passed) {
+        for (uint32_t i = 0; i < maxColorAttachments - 1; ++i) {
+            if (frame.attachments[i].data) {
+                storeAttachment(frame.attachments[i], pixel, outFragment.gl_FragData[i]);
+            }
+        }
+    }
+    return overwritten;
+}
 
-        mem.framebuffer.color[index * 4 + 0] = r;
-        mem.framebuffer.color[index * 4 + 1] = g;
-        mem.framebuffer.color[index * 4 + 2] = b;
-        mem.framebuffer.color[index * 4 + 3] = alpha;
+// Writes depth and visible triangle of a sample to visibility buffer, returns true if the sample is visible
+// overwritten is raised to the depth overwritten by a nearer one
+bool writeVisibility(GPUMemory &mem, float z, size_t index, uint64_t id, Pipeline const &pipeline, float &overwritten) {
+    uint32_t quantized = quantizeDepth(mem.framebuffer.depthFormat, z);
+    int comparison = compareDepth(mem.framebuffer, index, z, quantized);
+    if (comparison > 0) {
+        return false;
     }
+    overwritten = std::max(overwritten, replaceDepth(mem.framebuffer, index, z, quantized, comparison));
+    pipeline.visibility->ids[index] = id;
+    if (pipeline.samplesPassed) {
+        ++*pipeline.samplesPassed;
+    }
+    return true;
 }
 
-void rasterizeTriangle(GPUMemory &mem, Triangle &triangle, Program &prg) {
+void rasterizeTriangle(GPUMemory &mem, Triangle &triangle, Pipeline const &pipeline) {
     if (crossProduct(triangle) == 0.f) {
         return;
     }
@@ -278,38 +857,445 @@ void rasterizeTriangle(GPUMemory &mem, Triangle &triangle, Program &prg) {
     minY = std::max(minY, 0);
     maxY = std::min(maxY, (int)mem.framebuffer.height - 1);
 
-    for (int y = minY; y <= maxY; ++y) {
-        for (int x = minX; x <= maxX; ++x) {
-            auto p = glm::vec2{x + 0.5f, y + 0.5f};
-            auto barycentric = calculateBarycentric(triangle, p);
-            if (barycentric.x >= 0.f && barycentric.y >= 0.f && barycentric.z >= 0.f) {
-                rasterizeFragment(mem, triangle, barycentric, p, prg);
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+
+    // Nearest depth of the triangle, tiles whose max depth is nearer are hidden
+    float minZ = std::min(triangle.vertices[0].gl_Position.z, std::min(triangle.vertices[1].gl_Position.z, triangle.vertices[2].gl_Position.z));
+    Frame &frame = mem.framebuffer;
+
+    // Visible triangles are only recorded, they are shaded by visibility buffer resolve
+    bool visibility = pipeline.fragmentMode == FragmentMode::VISIBILITY;
+    uint64_t id = visibility ? packVisibility(pipeline.visibilityDraw, static_cast<uint32_t>(pipeline.visibility->draws[pipeline.visibilityDraw].triangles.size())) : 0;
+    bool visible = false;
+
+    // Bounding box is walked tile by tile, fully hidden triangles cost one test per tile
+    for (int tileY = minY / (int)hiZTileSize; tileY <= maxY / (int)hiZTileSize; ++tileY) {
+        for (int tileX = minX / (int)hiZTileSize; tileX <= maxX / (int)hiZTileSize; ++tileX) {
+            if (frame.hiZ && hiddenByHiZ(frame, minZ, frame.hiZ[tileX + tileY * hiZWidth(frame)])) {
+                continue;
+            }
+            if (frame.fastClear && frame.fastClear->tiles) {
+                materializeTile(frame, tileX, tileY);
+            }
+
+            // Max depth of the tile can only change if a sample at the max depth got nearer
+            float overwritten = -std::numeric_limits<float>::infinity();
+            int endY = std::min((tileY + 1) * (int)hiZTileSize - 1, maxY);
+            int endX = std::min((tileX + 1) * (int)hiZTileSize - 1, maxX);
+            for (int y = std::max(tileY * (int)hiZTileSize, minY); y <= endY; ++y) {
+                for (int x = std::max(tileX * (int)hiZTileSize, minX); x <= endX; ++x) {
+                    Coverage coverage = pixelCoverage(triangle, x, y, frame.samples);
+                    if (!coverage.mask) {
+                        continue;
+                    }
+                    if (!visibility) {
+                        overwritten = std::max(overwritten, rasterizeFragment(mem, triangle, coverage, glm::vec2{x + 0.5f, y + 0.5f}, pipeline));
+                        continue;
+                    }
+                    size_t index = pixelIndex(frame, x, y) * frame.samples;
+                    for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+                        if (coverage.mask >> sample & 1) {
+                            visible |= writeVisibility(mem, coverage.z[sample], index + sample, id, pipeline, overwritten);
+                        }
+                    }
+                }
+            }
+
+            if (frame.hiZ && overwritten >= frame.hiZ[tileX + tileY * hiZWidth(frame)]) {
+                updateHiZTile(frame, tileX, tileY);
+            }
+        }
+    }
+
+    if (visible) {
+        pipeline.visibility->draws[pipeline.visibilityDraw].triangles.push_back(triangle);
+    }
+}
+
+// Sets up pipeline state shared by all draws of a command
+Pipeline setupPipeline(GPUMemory &mem, int32_t programID, VertexArray const &vao, bool backfaceCulling, Topology topology, FragmentMode fragmentMode) {
+    Pipeline pipeline;
+    pipeline.prg = &std::as_const(mem).programs[programID];
+    pipeline.vao = &vao;
+    pipeline.si.uniforms = mem.uniforms.data();
+    pipeline.si.textures = mem.textures.data();
+    pipeline.si.nofUniforms = static_cast<uint32_t>(mem.uniforms.size());
+    pipeline.si.nofTextures = static_cast<uint32_t>(mem.textures.size());
+    pipeline.backfaceCulling = backfaceCulling;
+    pipeline.topology = topology;
+    pipeline.fragmentMode = fragmentMode;
+    return pipeline;
+}
+
+// Returns uniform block bound to a draw or nullptr if no uniform buffer is bound
+void const *uniformBlock(GPUMemory const &mem, int32_t uniformBufferID, uint32_t block) {
+    if (uniformBufferID < 0) {
+        return nullptr;
+    }
+    return mem.uniformBuffers[uniformBufferID].blockData(block);
+}
+
+// Runs program prologue once per draw, derived constants are shared by all shader invocations of the draw
+void runPrologue(Pipeline &pipeline) {
+    if (!pipeline.prg->prologue) {
+        pipeline.si.constants = nullptr;
+        return;
+    }
+    pipeline.prg->prologue(pipeline.constants, pipeline.si);
+    pipeline.si.constants = pipeline.constants;
+}
+
+// Processes assembled triangle and rasterizes it
+void processTriangle(GPUMemory &mem, Pipeline const &pipeline, Triangle &triangle) {
+    // Performs perspective division
+    perspectiveDivision(triangle);
+
+    // Performs viewport transformation
+    viewportTransformation(triangle, mem);
+
+    // Skip triangle if facing way from the viewer and backfaceCulling is enabled
+    if (pipeline.backfaceCulling && isBackface(triangle)) {
+        return;
+    }
+
+    rasterizeTriangle(mem, triangle, pipeline);
+}
+
+// Assembles triangles of a strip or a fan, vertices shared by consecutive triangles are shaded only once
+void drawStripOrFan(GPUMemory &mem, Pipeline const &pipeline, DrawRecord const &draw, uint32_t instanceID) {
+    VertexArray const &vao = *pipeline.vao;
+    bool restart = vao.primitiveRestart && vao.indexBufferID != -1;
+    uint32_t restartValue = restartIndex(vao.indexType);
+
+    // Strip keeps last two vertices, fan keeps the first and the last vertex
+    OutVertex shared[2];
+    // Number of vertices of the current strip or fan
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < draw.nofVertices; ++i) {
+        // Restart index starts a new strip or fan
+        if (restart && fetchIndex(mem, vao, draw, i) == restartValue) {
+            count = 0;
+            continue;
+        }
+
+        OutVertex vertex;
+        shadeVertex(vertex, mem, pipeline, draw, instanceID, i);
+
+        if (count >= 2) {
+            Triangle triangle;
+            // Odd triangles of a strip have swapped first two vertices to keep the winding
+            bool swap = pipeline.topology == Topology::TRIANGLE_STRIP && count % 2 == 1;
+            triangle.vertices[0] = shared[swap ? 1 : 0];
+            triangle.vertices[1] = shared[swap ? 0 : 1];
+            triangle.vertices[2] = vertex;
+            processTriangle(mem, pipeline, triangle);
+        }
+
+        if (pipeline.topology == Topology::TRIANGLE_FAN) {
+            shared[count == 0 ? 0 : 1] = vertex;
+        } else {
+            shared[0] = shared[1];
+            shared[1] = vertex;
+        }
+        ++count;
+    }
+}
+
+// Handles triangle drawing of one draw
+void drawTriangles(GPUMemory &mem, Pipeline const &pipeline, DrawRecord const &draw) {
+    // Iterate through all instances
+    for (uint32_t instance = 0; instance < draw.nofInstances; ++instance) {
+        if (pipeline.topology != Topology::TRIANGLES) {
+            drawStripOrFan(mem, pipeline, draw, instance);
+            continue;
+        }
+
+        // Iterate through all triangles
+        for (uint32_t i = 0; i < draw.nofVertices / 3; ++i) {
+            Triangle triangle;
+            // Assembles the triangle
+            triangleAssembly(triangle, mem, pipeline, draw, instance, i);
+
+            processTriangle(mem, pipeline, triangle);
+        }
+    }
+}
+
+// Returns how fragments of a draw are processed in a pass
+FragmentMode fragmentMode(bool depthOnly, bool opaque, Pass pass) {
+    if (pass == Pass::DEPTH_PREPASS) {
+        return opaque ? FragmentMode::DEPTH_ONLY : FragmentMode::NONE;
+    }
+    if (pass == Pass::VISIBILITY) {
+        return depthOnly ? FragmentMode::DEPTH_ONLY : opaque ? FragmentMode::VISIBILITY : FragmentMode::NONE;
+    }
+    if (pass == Pass::TRANSLUCENT) {
+        return depthOnly || opaque ? FragmentMode::NONE : FragmentMode::SHADE;
+    }
+    if (depthOnly) {
+        return FragmentMode::DEPTH_ONLY;
+    }
+    if (pass == Pass::SHADING && opaque) {
+        return FragmentMode::DEPTH_EQUAL;
+    }
+    return FragmentMode::SHADE;
+}
+
+// Samples of a draw are counted only in one pass, opaque draws are counted in the first pass in command order like in forward execution
+bool countsSamples(bool opaque, Pass pass) {
+    if (pass == Pass::DEPTH_PREPASS) {
+        return opaque;
+    }
+    if (pass == Pass::SHADING) {
+        return !opaque;
+    }
+    return true;
+}
+
+// Records pipeline state of a draw that writes visibility buffer, the resolve shades its triangles later
+void recordVisibilityDraw(Pipeline &pipeline) {
+    if (pipeline.fragmentMode != FragmentMode::VISIBILITY) {
+        return;
+    }
+    pipeline.visibilityDraw = static_cast<uint32_t>(pipeline.visibility->draws.size());
+    pipeline.visibility->draws.push_back({pipeline, {}});
+}
+
+// Shades visible triangle of every pixel of visibility buffer, fragment shader runs once per pixel
+void resolveVisibility(GPUMemory &mem, VisibilityBuffer &visibility) {
+    // Recorded pipelines are copies, constants have to point to their own scratch block
+    for (auto &draw : visibility.draws) {
+        draw.pipeline.fragmentMode = FragmentMode::SHADE;
+        // Samples were counted when the visibility buffer was written
+        draw.pipeline.samplesPassed = nullptr;
+        if (draw.pipeline.si.constants) {
+            draw.pipeline.si.constants = draw.pipeline.constants;
+        }
+    }
+
+    Frame &frame = mem.framebuffer;
+    uint32_t allSamples = (1u << frame.samples) - 1;
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        for (uint32_t x = 0; x < frame.width; ++x) {
+            // Every triangle visible in the pixel is shaded once for all samples it covers
+            size_t index = pixelIndex(frame, x, y) * frame.samples;
+            for (uint32_t remaining = allSamples; remaining;) {
+                uint32_t first = 0;
+                while (!(remaining >> first & 1)) {
+                    ++first;
+                }
+                uint64_t id = visibility.ids[index + first];
+                uint32_t mask = 0;
+                for (uint32_t sample = 0; sample < frame.samples; ++sample) {
+                    if (visibility.ids[index + sample] == id) {
+                        mask |= 1u << sample;
+                    }
+                }
+                remaining &= ~mask;
+                if (id == VisibilityBuffer::empty) {
+                    continue;
+                }
+                VisibilityDraw &draw = visibility.draws[id >> 32];
+                Triangle &triangle = draw.triangles[id & 0xffffffffu];
+                Coverage coverage = pixelCoverage(triangle, x, y, frame.samples);
+                coverage.mask &= mask;
+                rasterizeFragment(mem, triangle, coverage, glm::vec2{x + 0.5f, y + 0.5f}, draw.pipeline);
             }
         }
     }
 }
 
-// Handles triangle drawing
-void draw(GPUMemory &mem, DrawCommand cmd, uint32_t drawID) {
-    Program prg = mem.programs[cmd.programID];
-    // Iterate through all triangles
-    for (uint32_t i = 0; i < cmd.nofVertices / 3; ++i) {
-        Triangle triangle;
-        // Assembles the triangle
-        triangleAssembly(triangle, mem, cmd, drawID, i);
+// Handles draw command
+void draw(GPUMemory &mem, DrawCommand const &cmd, uint32_t drawID, Pass pass, WeightedBlendBuffer &weighted, VisibilityBuffer *visibility, uint64_t *samplesPassed) {
+    FragmentMode mode = fragmentMode(cmd.depthOnly, cmd.opaque, pass);
+    if (mode == FragmentMode::NONE) {
+        return;
+    }
+
+    Pipeline pipeline = setupPipeline(mem, cmd.programID, cmd.vao, cmd.backfaceCulling, cmd.topology, mode);
+    pipeline.blendMode = cmd.blendMode;
+    pipeline.visibility = visibility;
+    pipeline.weighted = &weighted;
+    if (cmd.blendMode == BlendMode::WEIGHTED) {
+        prepareWeighted(mem.framebuffer, weighted);
+    }
+    pipeline.samplesPassed = countsSamples(cmd.opaque, pass) ? samplesPassed : nullptr;
+    pipeline.si.uniformBlock = uniformBlock(mem, cmd.uniformBufferID, cmd.uniformBlock);
+    runPrologue(pipeline);
+    recordVisibilityDraw(pipeline);
+
+    DrawRecord record;
+    record.nofVertices = cmd.nofVertices;
+    record.nofInstances = cmd.nofInstances;
+    record.drawID = drawID;
+
+    drawTriangles(mem, pipeline, record);
+}
+
+// Returns draw records of multi draw command or nullptr if they do not fit into the draw buffer
+DrawRecord const *drawRecords(GPUMemory const &mem, MultiDrawCommand const &cmd) {
+    // Buffers behind the table (and negative ids) are default buffers without data
+    Buffer const &buffer = mem.buffers[cmd.drawBufferID];
+    if (!buffer.data || cmd.drawOffset > buffer.size) {
+        return nullptr;
+    }
+    if ((buffer.size - cmd.drawOffset) / sizeof(DrawRecord) < cmd.nofDraws) {
+        return nullptr;
+    }
+    return reinterpret_cast<const DrawRecord*>(static_cast<const uint8_t*>(buffer.data) + cmd.drawOffset);
+}
+
+// Handles multi draw command, pipeline is set up once and draw records are iterated
+// Commands whose draw records lie outside of the draw buffer are skipped
+void multiDraw(GPUMemory &mem, MultiDrawCommand const &cmd, Pass pass, WeightedBlendBuffer &weighted, VisibilityBuffer *visibility, uint64_t *samplesPassed) {
+    FragmentMode mode = fragmentMode(cmd.depthOnly, cmd.opaque, pass);
+    if (mode == FragmentMode::NONE) {
+        return;
+    }
+    DrawRecord const *records = drawRecords(mem, cmd);
+    if (!records) {
+        return;
+    }
+
+    Pipeline pipeline = setupPipeline(mem, cmd.programID, cmd.vao, cmd.backfaceCulling, cmd.topology, mode);
+    pipeline.blendMode = cmd.blendMode;
+    pipeline.visibility = visibility;
+    pipeline.weighted = &weighted;
+    if (cmd.blendMode == BlendMode::WEIGHTED) {
+        prepareWeighted(mem.framebuffer, weighted);
+    }
+    pipeline.samplesPassed = countsSamples(cmd.opaque, pass) ? samplesPassed : nullptr;
+
+    for (uint32_t i = 0; i < cmd.nofDraws; ++i) {
+        // Every draw binds block of the uniform buffer selected by its draw id
+        pipeline.si.uniformBlock = uniformBlock(mem, cmd.uniformBufferID, records[i].drawID);
+        runPrologue(pipeline);
+        recordVisibilityDraw(pipeline);
+        drawTriangles(mem, pipeline, records[i]);
+    }
+}
+
+// Occlusion queries are reset by the first pass over commands
+bool resetsQueries(Pass pass) {
+    return pass == Pass::FORWARD || pass == Pass::DEPTH_PREPASS || pass == Pass::VISIBILITY;
+}
+
+// Executes commands [begin, end) in a pass, returns draw id of the next draw
+// activeQuery is index of the active occlusion query or -1, it is updated by query commands
+// Weighted fragments are composited before clear
+uint32_t executeCommands(GPUMemory &mem, CommandBuffer &cb, uint32_t begin, uint32_t end, uint32_t drawid, Pass pass, int32_t &activeQuery, WeightedBlendBuffer &weighted, VisibilityBuffer *visibility = nullptr) {
+    for (uint32_t i = begin; i < end; ++i) {
+        CommandType type = cb.commands[i].type;
+        CommandData const &data = cb.commands[i].data;
+
+        // Clear command
+        if (type == CommandType::CLEAR) {
+            compositeWeighted(mem.framebuffer, weighted);
+            clear(mem, data.clearCommand);
+        }
+
+        // Begin query command, the result is reset when the query is started
+        if (type == CommandType::BEGIN_QUERY) {
+            activeQuery = static_cast<int32_t>(data.queryCommand.queryID);
+            if (resetsQueries(pass)) {
+                mem.queries[activeQuery] = 0;
+            }
+        }
 
-        // Performs perspective division
-        perspectiveDivision(triangle);
+        // End query command
+        if (type == CommandType::END_QUERY) {
+            activeQuery = -1;
+        }
 
-        // Performs viewport transformation
-        viewportTransformation(triangle, mem);
+        uint64_t *samplesPassed = activeQuery >= 0 ? &mem.queries[activeQuery] : nullptr;
 
-        // Skip triangle if facing way from the viewer and backfaceCulling is enabled
-        if (cmd.backfaceCulling && isBackface(triangle)) {
-            return;
+        // Draw command
+        if (type == CommandType::DRAW) {
+            draw(mem, data.drawCommand, drawid, pass, weighted, visibility, samplesPassed);
+            ++drawid;
         }
 
-        rasterizeTriangle(mem, triangle, prg);
+        // Multi draw command, draw ids are taken from the draw records
+        if (type == CommandType::MULTI_DRAW) {
+            multiDraw(mem, data.multiDrawCommand, pass, weighted, visibility, samplesPassed);
+            drawid += data.multiDrawCommand.nofDraws;
+        }
+    }
+    return drawid;
+}
+
+// Executes commands between clear commands in several passes:
+// Z-prepass writes depth of opaque draws first and then only visible fragments of opaque draws are shaded,
+// visibility buffer records visible triangles of opaque draws, shades them once per pixel and then shades the rest
+// Commands [first, last) are executed, returns draw id of the next draw
+uint32_t executeInPasses(GPUMemory &mem, CommandBuffer &cb, uint32_t first, uint32_t last, uint32_t drawid, int32_t &activeQuery, WeightedBlendBuffer &weighted) {
+    VisibilityBuffer visibility;
+    if (cb.executionMode == ExecutionMode::VISIBILITY_BUFFER) {
+        visibility.ids.resize(frameSize(mem.framebuffer) * mem.framebuffer.samples);
+    }
+
+    uint32_t begin = first;
+    while (begin < last) {
+        if (cb.commands[begin].type == CommandType::CLEAR) {
+            compositeWeighted(mem.framebuffer, weighted);
+            clear(mem, cb.commands[begin].data.clearCommand);
+            ++begin;
+            continue;
+        }
+
+        uint32_t end = begin;
+        while (end < last && cb.commands[end].type != CommandType::CLEAR) {
+            ++end;
+        }
+
+        // Every pass starts with the query that is active at the beginning of the commands
+        int32_t const segmentQuery = activeQuery;
+        if (cb.executionMode == ExecutionMode::Z_PREPASS) {
+            executeCommands(mem, cb, begin, end, drawid, Pass::DEPTH_PREPASS, activeQuery, weighted);
+            activeQuery = segmentQuery;
+            drawid = executeCommands(mem, cb, begin, end, drawid, Pass::SHADING, activeQuery, weighted);
+        } else {
+            std::fill(visibility.ids.begin(), visibility.ids.end(), VisibilityBuffer::empty);
+            visibility.draws.clear();
+            executeCommands(mem, cb, begin, end, drawid, Pass::VISIBILITY, activeQuery, weighted, &visibility);
+            resolveVisibility(mem, visibility);
+            activeQuery = segmentQuery;
+            drawid = executeCommands(mem, cb, begin, end, drawid, Pass::TRANSLUCENT, activeQuery, weighted);
+        }
+        begin = end;
+    }
+    return drawid;
+}
+
+// Frame that is rendered to, multisampled frames are rendered to their samples
+Frame renderTarget(Frame const &frame) {
+    Frame target = frame;
+    if (frame.samples == maxSamples && frame.sampleColor && frame.sampleDepth) {
+        target.color = frame.sampleColor;
+        target.depth = frame.sampleDepth;
+    } else {
+        target.samples = 1;
+    }
+    return target;
+}
+
+// Averages colors of samples of every pixel, depth of a pixel is the depth of its first sample
+void resolveSamples(Frame &frame, Frame const &target) {
+    size_t depthSize = frame.depthFormat == DepthFormat::UNORM16 ? sizeof(uint16_t) : sizeof(float);
+    for (size_t i = 0; i < frameSize(frame); ++i) {
+        uint8_t const *samples = target.color + i * target.samples * 4;
+        for (uint32_t c = 0; c < 4; ++c) {
+            uint32_t sum = 0;
+            for (uint32_t sample = 0; sample < target.samples; ++sample) {
+                sum += samples[sample * 4 + c];
+            }
+            frame.color[i * 4 + c] = static_cast<uint8_t>((sum + target.samples / 2) / target.samples);
+        }
+        std::memcpy(reinterpret_cast<uint8_t *>(frame.depth) + i * depthSize,
+                    reinterpret_cast<uint8_t const *>(target.depth) + i * target.samples * depthSize, depthSize);
     }
 }
 
@@ -323,26 +1309,104 @@ void gpu_execute(GPUMemory&mem,CommandBuffer &cb){
   /// cb obsahuje command buffer pro zpracování.
   /// Bližší informace jsou uvedeny na hlavní stránce dokumentace.
 
+    Frame frame = mem.framebuffer;
+    Frame bound = frame;
     uint32_t drawid = 0;
+    int32_t activeQuery = -1;
+    WeightedBlendBuffer weighted;
 
-    for (uint32_t i = 0; i < cb.nofCommands; ++i) {
-        CommandType type = cb.commands[i].type;
-        CommandData data = cb.commands[i].data;
-
-        // Clear command
-        if (type == CommandType::CLEAR) {
-            clear(mem, data.clearCommand);
+    // Commands between bind framebuffer commands render to one frame
+    for (uint32_t begin = 0;;) {
+        uint32_t end = begin;
+        while (end < cb.nofCommands && cb.commands[end].type != CommandType::BIND_FRAMEBUFFER) {
+            ++end;
         }
 
-        // Draw command
-        if (type == CommandType::DRAW) {
-            draw(mem, data.drawCommand, drawid);
-            ++drawid;
+        // Multisampled frame is rendered to its samples, they are averaged by gpu_resolve
+        mem.framebuffer = renderTarget(bound);
+        if (cb.executionMode != ExecutionMode::FORWARD) {
+            drawid = executeInPasses(mem, cb, begin, end, drawid, activeQuery, weighted);
+        } else {
+            drawid = executeCommands(mem, cb, begin, end, drawid, Pass::FORWARD, activeQuery, weighted);
+        }
+        // Weighted fragments of the frame are composited after all its draws
+        compositeWeighted(mem.framebuffer, weighted);
+        if (end == cb.nofCommands) {
+            break;
         }
+
+        // Finished frame is resolved, following commands can read it as a texture
+        gpu_resolve(bound);
+        int32_t frameID = cb.commands[end].data.bindFramebufferCommand.frameID;
+        bound = frameID < 0 ? frame : std::as_const(mem).frames[frameID];
+        begin = end + 1;
     }
+
+    mem.framebuffer = frame;
 }
 //! [gpu_execute]
 
+void gpu_resolve(Frame &frame) {
+    Frame target = renderTarget(frame);
+    // Tiles that were not touched since the fast clear are filled now
+    if (target.fastClear && target.fastClear->tiles) {
+        for (uint32_t tileY = 0; tileY < hiZHeight(target); ++tileY) {
+            for (uint32_t tileX = 0; tileX < hiZWidth(target); ++tileX) {
+                materializeTile(target, tileX, tileY);
+            }
+        }
+    }
+    if (target.samples > 1) {
+        resolveSamples(frame, target);
+    }
+}
+
+void gpu_readFrame(Frame const &frame, uint8_t *color, float *depth) {
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        // Pixels are copied in runs that are contiguous in both layouts, a whole row or a row of a tile
+        uint32_t run = frame.layout == FrameLayout::TILED ? hiZTileSize : frame.width;
+        for (uint32_t x = 0; x < frame.width; x += run) {
+            size_t src = pixelIndex(frame, x, y);
+            size_t dst = x + static_cast<size_t>(y) * frame.width;
+            size_t count = std::min(run, frame.width - x);
+            if (color) {
+                std::memcpy(color + dst * 4, frame.color + src * 4, count * 4);
+            }
+            for (size_t i = 0; depth && i < count; ++i) {
+                depth[dst + i] = loadDepth(frame, src + i);
+            }
+        }
+    }
+}
+
+// Reads c-th channel of a texel in the format of a texture
+float readChannel(TextureFormat format, uint8_t const *texel, uint32_t c) {
+    switch (format) {
+        case TextureFormat::UNORM16: {
+            uint16_t value;
+            std::memcpy(&value, texel + c * sizeof(value), sizeof(value));
+            return value / 65535.f;
+        }
+        case TextureFormat::UNORM24: {
+            uint32_t value;
+            std::memcpy(&value, texel, sizeof(value));
+            return (value & 0xffffffu) / 16777215.f;
+        }
+        case TextureFormat::FLOAT16: {
+            uint16_t value;
+            std::memcpy(&value, texel + c * sizeof(value), sizeof(value));
+            return glm::unpackHalf1x16(value);
+        }
+        case TextureFormat::FLOAT32: {
+            float value;
+            std::memcpy(&value, texel + c * sizeof(value), sizeof(value));
+            return value;
+        }
+        default:
+            return texel[c] / 255.f;
+    }
+}
+
 /**
  * @brief This function reads color from texture.
  *
@@ -358,7 +1422,8 @@ glm::vec4 read_texture(Texture const&texture,glm::vec2 uv){
   auto pix = glm::uvec2(uv2);
   //auto t   = glm::fract(uv2);
   glm::vec4 color = glm::vec4(0.f,0.f,0.f,1.f);
+  auto texel = texture.data+layoutIndex(texture.layout,texture.width,pix.x,pix.y)*texelSize(texture);
   for(uint32_t c=0;c<texture.channels;++c)
-    color[c] = texture.data[(pix.y*texture.width+pix.x)*texture.channels+c]/255.f;
+    color[c] = readChannel(texture.format,texel,c);
   return color;
 }
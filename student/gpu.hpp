@@ -19,4 +19,23 @@
  */
 void gpu_execute(GPUMemory&mem,CommandBuffer&cb);
 
+/**
+ * @brief function that fills tiles of the frame that are still pending after fast clear
+ * and averages samples of multisampled frame.
+ * It has to be called before the frame is presented or read outside of gpu.
+ *
+ * @param frame frame
+ */
+void gpu_resolve(Frame&frame);
+
+/**
+ * @brief function that copies color and depth of the frame to row major buffers.
+ * Frames in FrameLayout::TILED and with integer DepthFormat have to be read by it.
+ *
+ * @param frame frame
+ * @param color output color buffer (width*height*4 bytes) or nullptr
+ * @param depth output depth buffer (width*height floats, integer depth formats are converted) or nullptr
+ */
+void gpu_readFrame(Frame const&frame,uint8_t*color,float*depth);
+
 glm::vec4 read_texture(Texture const&texture,glm::vec2 uv);
@@ -0,0 +1,155 @@
+/*!
+ * @file
+ * @brief This file contains full screen post process filters that run over resolved frame.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+#include <student/postProcess.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// FXAA blurs along edges whose luma contrast exceeds max(fxaaEdgeThresholdMin, fxaaEdgeThreshold * maximal luma)
+float const fxaaEdgeThreshold    = 1.f / 8.f;
+float const fxaaEdgeThresholdMin = 1.f / 16.f;
+float const fxaaReduceMul        = 1.f / 8.f;
+float const fxaaReduceMin        = 1.f / 128.f;
+float const fxaaSpanMax          = 8.f;
+// Samples are at most fxaaSpanMax / 2 pixels away, bilinear filtering reads one more pixel
+uint32_t const fxaaRadius        = 5;
+
+float luma(glm::vec4 const &color) {
+    return glm::dot(glm::vec3(color), glm::vec3(.299f, .587f, .114f));
+}
+
+glm::vec4 fxaa(PostProcessInput const &input, uint32_t x, uint32_t y, void const *) {
+    int32_t const ix = static_cast<int32_t>(x);
+    int32_t const iy = static_cast<int32_t>(y);
+    glm::vec4 const center = input.fetch(ix, iy);
+
+    float const lumaM  = luma(center);
+    float const lumaNW = luma(input.fetch(ix - 1, iy - 1));
+    float const lumaNE = luma(input.fetch(ix + 1, iy - 1));
+    float const lumaSW = luma(input.fetch(ix - 1, iy + 1));
+    float const lumaSE = luma(input.fetch(ix + 1, iy + 1));
+
+    float const lumaMin = std::min({lumaM, lumaNW, lumaNE, lumaSW, lumaSE});
+    float const lumaMax = std::max({lumaM, lumaNW, lumaNE, lumaSW, lumaSE});
+
+    // Pixels without contrast are not on an edge and are kept
+    if (lumaMax - lumaMin < std::max(fxaaEdgeThresholdMin, lumaMax * fxaaEdgeThreshold)) {
+        return center;
+    }
+
+    // Direction along the edge, it is perpendicular to the luma gradient
+    glm::vec2 dir = glm::vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float const dirReduce = std::max((lumaNW + lumaNE + lumaSW + lumaSE) * .25f * fxaaReduceMul, fxaaReduceMin);
+    float const rcpDirMin = 1.f / (std::min(std::abs(dir.x), std::abs(dir.y)) + dirReduce);
+    dir = glm::clamp(dir * rcpDirMin, glm::vec2(-fxaaSpanMax), glm::vec2(fxaaSpanMax));
+
+    glm::vec2 const p = glm::vec2(x, y) + .5f;
+    glm::vec4 const colorA = .5f * (input.sample(p + dir * (1.f / 3.f - .5f)) + input.sample(p + dir * (2.f / 3.f - .5f)));
+    glm::vec4 const colorB = colorA * .5f + .25f * (input.sample(p - dir * .5f) + input.sample(p + dir * .5f));
+
+    // Wider blur is used only if it does not leave the luma range of the neighborhood
+    float const lumaB = luma(colorB);
+    glm::vec4 result = lumaB < lumaMin || lumaB > lumaMax ? colorA : colorB;
+    result.a = center.a;
+    return result;
+}
+
+PostProcessFilter fxaaFilter() {
+    PostProcessFilter filter;
+    filter.function = fxaa;
+    filter.radius = fxaaRadius;
+    return filter;
+}
+
+// Index of the first pixel of the row in color buffer, rows of tiled frames have to start a row of tiles
+size_t rowOffset(Frame const &frame, uint32_t row) {
+    if (frame.layout == FrameLayout::TILED) {
+        size_t tilesX = (frame.width + hiZTileSize - 1) / hiZTileSize;
+        return (row + hiZTileSize - 1) / hiZTileSize * tilesX * hiZTileSize * hiZTileSize;
+    }
+    return static_cast<size_t>(row) * frame.width;
+}
+
+// Pixels of a row are in groups of hiZTileSize, index of pixel x is begin + x / hiZTileSize * stride + x % hiZTileSize
+struct RowLayout {
+    size_t begin;
+    size_t stride;
+};
+
+RowLayout rowLayout(Frame const &frame, uint32_t y) {
+    if (frame.layout == FrameLayout::TILED) {
+        return {layoutIndex(frame.layout, frame.width, 0, y), hiZTileSize * hiZTileSize};
+    }
+    return {static_cast<size_t>(y) * frame.width, hiZTileSize};
+}
+
+// Filters rows [begin, end) of the frame to output, the frame is not modified
+void filterBand(Frame const &frame, PostProcessFilter const &filter, uint32_t begin, uint32_t end, std::vector<uint8_t> &output) {
+    // Rows of the band and halo rows are converted to floats once
+    PostProcessInput input;
+    input.width = frame.width;
+    input.height = frame.height;
+    input.firstRow = begin > filter.radius ? begin - filter.radius : 0;
+    input.lastRow = std::min(end + filter.radius, frame.height) - 1;
+
+    std::vector<glm::vec4> rows(static_cast<size_t>(input.lastRow - input.firstRow + 1) * frame.width);
+    for (uint32_t y = input.firstRow; y <= input.lastRow; ++y) {
+        RowLayout row = rowLayout(frame, y);
+        glm::vec4 *dst = rows.data() + static_cast<size_t>(y - input.firstRow) * frame.width;
+        for (uint32_t x = 0; x < frame.width; ++x) {
+            uint8_t const *pixel = frame.color + (row.begin + x / hiZTileSize * row.stride + x % hiZTileSize) * 4;
+            dst[x] = glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) * (1.f / 255.f);
+        }
+    }
+    input.rows = rows.data();
+
+    // Output starts as a copy of the band, so padding of tiles is kept
+    size_t offset = rowOffset(frame, begin);
+    output.assign(frame.color + offset * 4, frame.color + rowOffset(frame, end) * 4);
+    for (uint32_t y = begin; y < end; ++y) {
+        RowLayout row = rowLayout(frame, y);
+        for (uint32_t x = 0; x < frame.width; ++x) {
+            glm::vec4 color = glm::clamp(filter.function(input, x, y, filter.parameters), 0.f, 1.f) * 255.f + .5f;
+            uint8_t *pixel = output.data() + (row.begin + x / hiZTileSize * row.stride + x % hiZTileSize - offset) * 4;
+            for (int c = 0; c < 4; ++c) {
+                pixel[c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+    }
+}
+
+void postProcess(Frame &frame, PostProcessFilter const &filter, uint32_t nofThreads) {
+    if (!filter.function || !frame.color || frame.width == 0 || frame.height == 0) {
+        return;
+    }
+    if (nofThreads == 0) {
+        nofThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Bands are whole rows of tiles, so every band of a tiled frame is contiguous
+    uint32_t tileRows = (frame.height + hiZTileSize - 1) / hiZTileSize;
+    uint32_t bandRows = (tileRows + nofThreads - 1) / nofThreads * hiZTileSize;
+    uint32_t nofBands = (frame.height + bandRows - 1) / bandRows;
+
+    // Bands read halo rows of their neighbors, results are written back after all bands are filtered
+    std::vector<std::vector<uint8_t>> outputs(nofBands);
+    std::vector<std::thread> workers;
+    for (uint32_t band = 1; band < nofBands; ++band) {
+        uint32_t begin = band * bandRows;
+        workers.emplace_back(filterBand, std::cref(frame), std::cref(filter), begin, std::min(begin + bandRows, frame.height), std::ref(outputs[band]));
+    }
+    filterBand(frame, filter, 0, std::min(bandRows, frame.height), outputs[0]);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (uint32_t band = 0; band < nofBands; ++band) {
+        std::memcpy(frame.color + rowOffset(frame, band * bandRows) * 4, outputs[band].data(), outputs[band].size());
+    }
+}
@@ -0,0 +1,96 @@
+/*!
+ * @file
+ * @brief This file contains full screen post process filters that run over resolved frame.
+ *
+ * @author Tomáš Milet, imilet@fit.vutbr.cz
+ */
+#pragma once
+
+#include <student/fwd.hpp>
+
+/**
+ * @brief This struct represents input of a post process filter.
+ * The frame is filtered in bands of whole rows of tiles, bands can be filtered by several threads, every band is copied
+ * together with radius halo rows above and below it, so bands are filtered independently.
+ */
+//! [PostProcessInput]
+struct PostProcessInput{
+  glm::vec4 const*rows     = nullptr;///< colors of rows [firstRow, lastRow], row by row
+  uint32_t        width    = 0      ;///< width of the frame
+  uint32_t        height   = 0      ;///< height of the frame
+  uint32_t        firstRow = 0      ;///< first row of the band including halo
+  uint32_t        lastRow  = 0      ;///< last row of the band including halo
+  /**
+   * @brief This function returns color of a pixel, coordinates are clamped to the frame
+   *
+   * @param x x coordinate of the pixel
+   * @param y y coordinate of the pixel, it has to be at most radius rows from the filtered pixel
+   *
+   * @return color
+   */
+  glm::vec4 fetch(int32_t x,int32_t y)const{
+    x = glm::clamp(x,0,(int32_t)width-1);
+    y = glm::clamp(y,(int32_t)firstRow,(int32_t)lastRow);
+    return rows[(size_t)(y-firstRow)*width+x];
+  }
+  /**
+   * @brief This function returns bilinearly filtered color, pixel centers are at +0.5
+   *
+   * @param p position in pixels
+   *
+   * @return color
+   */
+  glm::vec4 sample(glm::vec2 p)const{
+    p -= .5f;
+    auto const f = glm::floor(p);
+    auto const t = p-f;
+    auto const x = (int32_t)f.x;
+    auto const y = (int32_t)f.y;
+    return glm::mix(
+        glm::mix(fetch(x,y  ),fetch(x+1,y  ),t.x),
+        glm::mix(fetch(x,y+1),fetch(x+1,y+1),t.x),t.y);
+  }
+};
+//! [PostProcessInput]
+
+/**
+ * @brief This function type represents post process filter, it computes one output pixel.
+ *
+ * @param input input of the filter
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ * @param parameters parameters of the filter or nullptr
+ *
+ * @return color of the pixel
+ */
+using PostProcessFunction = glm::vec4(*)(PostProcessInput const&input,uint32_t x,uint32_t y,void const*parameters);
+
+/**
+ * @brief This struct represents post process filter (FXAA, tone mapping, color grading, ...).
+ */
+//! [PostProcessFilter]
+struct PostProcessFilter{
+  PostProcessFunction function   = nullptr;///< filter function
+  uint32_t            radius     = 0      ;///< radius of neighborhood read by the filter in pixels (number of halo rows)
+  void        const*  parameters = nullptr;///< parameters passed to the filter
+};
+//! [PostProcessFilter]
+
+/**
+ * @brief This function returns FXAA filter.
+ * It blurs pixels on edges with high luma contrast along the edge, it is a cheap alternative to supersampling.
+ *
+ * @return filter
+ */
+PostProcessFilter fxaaFilter();
+
+/**
+ * @brief This function runs post process filter over color buffer of the frame.
+ * Frame has to be resolved by gpu_resolve.
+ * By default the filter runs on the calling thread, threads for more bands are created and joined by every call.
+ *
+ * @param frame frame
+ * @param filter filter
+ * @param nofThreads number of threads, 1 - calling thread only, 0 - number of hardware threads
+ */
+void postProcess(Frame&frame,PostProcessFilter const&filter,uint32_t nofThreads = 1);
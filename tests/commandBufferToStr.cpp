@@ -8,17 +8,55 @@ std::string commandTypeToStr(CommandType const&type){
   switch(type){
     case CommandType::CLEAR:return "CLEAR";
     case CommandType::DRAW :return "DRAW" ;
+    case CommandType::MULTI_DRAW:return "MULTI_DRAW";
+    case CommandType::BEGIN_QUERY:return "BEGIN_QUERY";
+    case CommandType::END_QUERY:return "END_QUERY";
+    case CommandType::BIND_FRAMEBUFFER:return "BIND_FRAMEBUFFER";
     case CommandType::EMPTY:return "EMPTY";
   }
   return "";
 }
 
+std::string blendModeToStr(BlendMode mode){
+  switch(mode){
+    case BlendMode::ALPHA        :return "ALPHA";
+    case BlendMode::OFF          :return "OFF";
+    case BlendMode::ADDITIVE     :return "ADDITIVE";
+    case BlendMode::PREMULTIPLIED:return "PREMULTIPLIED";
+    case BlendMode::WEIGHTED     :return "WEIGHTED";
+  }
+  return "";
+}
+
 std::string clearCommandToStr(size_t p,uint32_t i,ClearCommand const&cmd){
   std::stringstream ss;
   ss << padding(p)<<"cb.commands["<<i<<"].data.clearCommand.color      = glm::vec4"<<str(cmd.color) <<";"<<std::endl;
   ss << padding(p)<<"cb.commands["<<i<<"].data.clearCommand.depth      = "<<cmd.depth               <<";"<<std::endl;
   ss << padding(p)<<"cb.commands["<<i<<"].data.clearCommand.clearColor = "<<str(cmd.clearColor)     <<";"<<std::endl;
   ss << padding(p)<<"cb.commands["<<i<<"].data.clearCommand.clearDepth = "<<str(cmd.clearDepth)     <<";"<<std::endl;
+  ss << padding(p)<<"cb.commands["<<i<<"].data.clearCommand.fast       = "<<str(cmd.fast)           <<";"<<std::endl;
+  return ss.str();
+}
+
+std::string vertexArrayToStr(size_t p,uint32_t i,std::string const&cmdName,VertexArray const&vao){
+  std::stringstream ss;
+  auto const prefix = "cb.commands["+std::to_string(i)+"].data."+cmdName+".vao.";
+  if(vao.indexBufferID>=0){
+    ss << padding(p) << prefix << "indexBufferID = " << vao.indexBufferID  << ";" << std::endl;
+    ss << padding(p) << prefix << "indexOffset   = " << vao.indexOffset    << ";" << std::endl;
+    ss << padding(p) << prefix << "indexType     = " << str(vao.indexType) << ";" << std::endl;
+    if(vao.primitiveRestart)
+      ss << padding(p) << prefix << "primitiveRestart = " << str(vao.primitiveRestart) << ";" << std::endl;
+  }
+  for(uint32_t j=0;j<maxAttributes;++j){
+    if(vao.vertexAttrib[j].type == AttributeType::EMPTY)continue;
+    ss << padding(p) << prefix << "vertexAttrib["<<j<<"].bufferID = " << vao.vertexAttrib[j].bufferID  << ";" << std::endl;
+    ss << padding(p) << prefix << "vertexAttrib["<<j<<"].offset   = " << vao.vertexAttrib[j].offset    << ";" << std::endl;
+    ss << padding(p) << prefix << "vertexAttrib["<<j<<"].stride   = " << vao.vertexAttrib[j].stride    << ";" << std::endl;
+    ss << padding(p) << prefix << "vertexAttrib["<<j<<"].type     = " << str(vao.vertexAttrib[j].type) << ";" << std::endl;
+    if(vao.vertexAttrib[j].divisor)
+      ss << padding(p) << prefix << "vertexAttrib["<<j<<"].divisor  = " << vao.vertexAttrib[j].divisor   << ";" << std::endl;
+  }
   return ss.str();
 }
 
@@ -27,18 +65,39 @@ std::string drawCommandToStr(size_t p,uint32_t i,DrawCommand const&cmd){
   ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.backfaceCulling = "<<str(cmd.backfaceCulling) <<";" << std::endl;
   ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.programID       = "<<cmd.programID            <<";" << std::endl;
   ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.nofVertices     = "<<cmd.nofVertices          <<";" << std::endl;
-  if(cmd.vao.indexBufferID>=0){
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.indexBufferID = " << cmd.vao.indexBufferID  << ";" << std::endl;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.indexOffset   = " << cmd.vao.indexOffset    << ";" << std::endl;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.indexType     = " << str(cmd.vao.indexType) << ";" << std::endl;
-  }
-  for(uint32_t j=0;j<maxAttributes;++j){
-    if(cmd.vao.vertexAttrib[j].type == AttributeType::EMPTY)continue;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.vertexAttrib["<<j<<"].bufferID = " << cmd.vao.vertexAttrib[j].bufferID  << ";" << std::endl;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.vertexAttrib["<<j<<"].offset   = " << cmd.vao.vertexAttrib[j].offset    << ";" << std::endl;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.vertexAttrib["<<j<<"].stride   = " << cmd.vao.vertexAttrib[j].stride    << ";" << std::endl;
-    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.vertexAttrib["<<j<<"].type     = " << str(cmd.vao.vertexAttrib[j].type) << ";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.nofInstances    = "<<cmd.nofInstances         <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.topology        = "<<str(cmd.topology)        <<";" << std::endl;
+  if(cmd.depthOnly)
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.depthOnly       = "<<str(cmd.depthOnly)       <<";" << std::endl;
+  if(cmd.opaque)
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.opaque          = "<<str(cmd.opaque)          <<";" << std::endl;
+  if(cmd.blendMode != BlendMode::ALPHA)
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.blendMode       = BlendMode::"<<blendModeToStr(cmd.blendMode)<<";" << std::endl;
+  if(cmd.uniformBufferID>=0){
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.uniformBufferID = "<<cmd.uniformBufferID      <<";" << std::endl;
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.uniformBlock    = "<<cmd.uniformBlock         <<";" << std::endl;
   }
+  ss << vertexArrayToStr(p,i,"drawCommand",cmd.vao);
+  return ss.str();
+}
+
+std::string multiDrawCommandToStr(size_t p,uint32_t i,MultiDrawCommand const&cmd){
+  std::stringstream ss;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.backfaceCulling = "<<str(cmd.backfaceCulling) <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.programID       = "<<cmd.programID            <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.drawBufferID    = "<<cmd.drawBufferID         <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.drawOffset      = "<<cmd.drawOffset           <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.nofDraws        = "<<cmd.nofDraws             <<";" << std::endl;
+  ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.topology        = "<<str(cmd.topology)        <<";" << std::endl;
+  if(cmd.depthOnly)
+    ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.depthOnly       = "<<str(cmd.depthOnly)       <<";" << std::endl;
+  if(cmd.opaque)
+    ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.opaque          = "<<str(cmd.opaque)          <<";" << std::endl;
+  if(cmd.blendMode != BlendMode::ALPHA)
+    ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.blendMode       = BlendMode::"<<blendModeToStr(cmd.blendMode)<<";" << std::endl;
+  if(cmd.uniformBufferID>=0)
+    ss << padding(p) << "cb.commands["<<i<<"].data.multiDrawCommand.uniformBufferID = "<<cmd.uniformBufferID      <<";" << std::endl;
+  ss << vertexArrayToStr(p,i,"multiDrawCommand",cmd.vao);
   return ss.str();
 }
 
@@ -52,6 +111,17 @@ std::string commandToStr(size_t p,uint32_t i,Command const&cmd){
     case CommandType::DRAW:
       ss << drawCommandToStr(p,i,cmd.data.drawCommand);
       break;
+    case CommandType::MULTI_DRAW:
+      ss << multiDrawCommandToStr(p,i,cmd.data.multiDrawCommand);
+      break;
+    case CommandType::BEGIN_QUERY:
+      ss << padding(p) << "cb.commands["<<i<<"].data.queryCommand.queryID = "<<cmd.data.queryCommand.queryID<<";" << std::endl;
+      break;
+    case CommandType::END_QUERY:
+      break;
+    case CommandType::BIND_FRAMEBUFFER:
+      ss << padding(p) << "cb.commands["<<i<<"].data.bindFramebufferCommand.frameID = "<<cmd.data.bindFramebufferCommand.frameID<<";" << std::endl;
+      break;
     case CommandType::EMPTY:
       break;
   }
@@ -62,6 +132,10 @@ std::string commandBufferToStr(size_t p,CommandBuffer const&cb){
   std::stringstream ss;
   ss << padding(p) << "CommandBuffer cb;" << std::endl;
   ss << padding(p) << "cb.nofCommands = " << cb.nofCommands << ";" << std::endl;
+  if(cb.executionMode == ExecutionMode::Z_PREPASS)
+    ss << padding(p) << "cb.executionMode = ExecutionMode::Z_PREPASS;" << std::endl;
+  if(cb.executionMode == ExecutionMode::VISIBILITY_BUFFER)
+    ss << padding(p) << "cb.executionMode = ExecutionMode::VISIBILITY_BUFFER;" << std::endl;
   for(uint32_t i=0;i<cb.nofCommands;++i)
     ss<<commandToStr(p,i,cb.commands[i]);
   return ss.str();
@@ -11,9 +11,12 @@
 
 #include <algorithm>
 #include <numeric>
+#include <glm/gtc/packing.hpp>
 
 #include <student/gpu.hpp>
+#include <student/postProcess.hpp>
 #include <framework/framebuffer.hpp>
+#include <framework/frameCache.hpp>
 
 using namespace tests;
 
@@ -454,3 +457,1148 @@ SCENARIO("03"){
   REQUIRE(false);
 }
 
+
+uint32_t countedVertices = 0;
+void vertexShaderCount(OutVertex&,InVertex const&,ShaderInterface const&){
+  countedVertices++;
+}
+
+// multi draws whose records lie outside of the draw buffer, returns number of executed vertices
+uint32_t countOutOfBufferDrawVertices(){
+  MEMCB();
+  auto framebuffer = std::make_shared<Framebuffer>(10,10);
+
+  std::vector<DrawRecord> draws(2);
+  draws[0].nofVertices = 3;
+  draws[1].nofVertices = 3;
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0]      = vectorToBuffer(draws);
+  mem.buffers[1].size = sizeof(DrawRecord)*2;
+  mem.programs[0].vertexShader   = vertexShaderCount  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+
+  pushMultiDrawCommand(cb,-1,1);                                     // negative buffer id
+  pushMultiDrawCommand(cb, 7,1);                                     // buffer that was never written
+  pushMultiDrawCommand(cb, 1,1);                                     // buffer without data
+  pushMultiDrawCommand(cb, 0,3);                                     // more records than the buffer holds
+  pushMultiDrawCommand(cb, 0,2,0,{},false,sizeof(DrawRecord)  );     // last record is behind the end
+  pushMultiDrawCommand(cb, 0,1,0,{},false,sizeof(DrawRecord)*3);     // offset behind the end
+  pushMultiDrawCommand(cb, 0,0xffffffffu,0,{},false,sizeof(DrawRecord));// size of records overflows
+
+  countedVertices = 0;
+  gpu_execute(mem,cb);
+  return countedVertices;
+}
+
+SCENARIO("45"){
+  std::cerr << "45 - multi draw command" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<float   > vert    = {0.f,1.f,2.f,3.f,4.f,5.f,6.f,7.f,8.f,9.f};
+  std::vector<uint16_t> indices = {0,1,2, 2,1,0, 3,3,3};
+
+  std::vector<DrawRecord> draws(3);
+  draws[0].nofVertices  = 3;
+  draws[0].drawID       = 7;
+  draws[1].nofVertices  = 6;
+  draws[1].baseVertex   = 4;
+  draws[1].drawID       = 3;
+  draws[2].nofVertices  = 3;
+  draws[2].nofInstances = 2;
+  draws[2].indexOffset  = sizeof(uint16_t)*3;
+  draws[2].baseVertex   = 1;
+  draws[2].drawID       = 5;
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(vert   );
+  mem.buffers[1] = vectorToBuffer(indices);
+  mem.buffers[2] = vectorToBuffer(draws  );
+  mem.programs[0].vertexShader   = vertexShaderDump0  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+  mem.programs[1].vertexShader   = vertexShaderDump1  ;
+  mem.programs[1].fragmentShader = fragmentShaderEmpty;
+
+  VertexArray vao;
+  vao.vertexAttrib[0].bufferID = 0;
+  vao.vertexAttrib[0].type     = AttributeType::FLOAT;
+  vao.vertexAttrib[0].stride   = sizeof(float);
+
+  VertexArray ivao = vao;
+  ivao.indexBufferID = 1;
+  ivao.indexType     = IndexType::UINT16;
+
+  pushMultiDrawCommand(cb,2,2,0,vao);
+  pushMultiDrawCommand(cb,2,1,1,ivao,false,sizeof(DrawRecord)*2);
+
+  dumpInject.init(&mem);
+
+  gpu_execute(mem,cb);
+
+  auto check = checkDump(mem,cb,DumpDiff::DIFFERENT_ATTRIBUTE);
+
+  auto const outOfBufferVertices = countOutOfBufferDrawVertices();
+
+  if(check.status == DumpDiff::SAME && outOfBufferVertices == 0)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test zkouší multi draw příkaz (CommandType::MULTI_DRAW).
+  Parametry jednotlivých kreslení jsou uloženy v bufferu jako pole struktur DrawRecord.
+  Každý záznam má počet vrcholů, počet instancí, offset do index bufferu v bajtech,
+  baseVertex, který se přičte ke gl_VertexID, a gl_DrawID, které se předá do shaderů.
+  Příkaz, jehož záznamy neexistují nebo nejsou celé uvnitř bufferu, se přeskočí.
+  )." << std::endl;
+
+  if(outOfBufferVertices != 0){
+    std::cerr << "  Příkazy se záznamy mimo buffer spustily vertex shader " << outOfBufferVertices << "x." << std::endl;
+    REQUIRE(false);
+  }
+
+  std::cerr << "  Takto to dopadlo:" << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << commandBufferDumpToStr(2,check);
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}
+
+SCENARIO("47"){
+  std::cerr << "47 - command buffer grows on demand and can be reset" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(10,10);
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.programs[0].vertexShader   = vertexShaderCount  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+
+  uint32_t const N = 12000;
+  for(uint32_t i=0;i<N;++i)
+    pushDrawCommand(cb,3,0);
+
+  countedVertices = 0;
+  gpu_execute(mem,cb);
+
+  auto capacity    = cb.commands.capacity();
+  auto firstCount  = countedVertices;
+
+  bool const grown = cb.nofCommands == N && capacity >= N && countedVertices == 3*N;
+
+  cb.reset();
+  pushClearCommand(cb);
+  pushDrawCommand(cb,3,0);
+
+  countedVertices = 0;
+  gpu_execute(mem,cb);
+
+  bool const reused = cb.nofCommands == 2 && cb.commands.capacity() == capacity && countedVertices == 3;
+
+  if(grown && reused)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Command buffer by měl růst podle potřeby (po blocích příkazů).
+  Do command bufferu bylo vloženo )."<<N<<R".( kreslících příkazů, každý se 3 vrcholy.
+  Vertex shader se spustil )."<<firstCount<<R".(x.
+  Po zavolání cb.reset() by měl být command buffer prázdný, ale alokovaná paměť by měla zůstat pro další snímek.
+  ).";
+  REQUIRE(false);
+}
+
+SCENARIO("52"){
+  std::cerr << "52 - frame fingerprint of gpu memory and command buffer" << std::endl;
+
+  MEMCB();
+
+  mem.uniforms[0].v4 = glm::vec4(1.f,2.f,3.f,4.f);
+  mem.uniformBuffers[0].block<float>(3) = 7.f;
+  pushClearCommand(cb,glm::vec4(.1f,.2f,.3f,1.f));
+  pushDrawCommand (cb,3,0);
+
+  auto const reference = fingerprint(mem,cb);
+
+  bool stable = fingerprint(mem,cb) == reference;
+
+  mem.uniforms[0].v4.w = 5.f;
+  bool uniformChange = fingerprint(mem,cb) != reference;
+  mem.uniforms[0].v4.w = 4.f;
+
+  mem.uniformBuffers[0].block<float>(3) = 8.f;
+  bool blockChange = fingerprint(mem,cb) != reference;
+  mem.uniformBuffers[0].block<float>(3) = 7.f;
+
+  cb.commands[1].data.drawCommand.nofVertices = 6;
+  bool commandChange = fingerprint(mem,cb) != reference;
+  cb.commands[1].data.drawCommand.nofVertices = 3;
+
+  bool restored = fingerprint(mem,cb) == reference;
+
+  // vertex array of draw command lies in the union behind the smaller clear command
+  cb.commands[0].data.drawCommand.vao.indexOffset = 123;
+  bool unusedBytes = fingerprint(mem,cb) == reference;
+
+  if(stable && uniformChange && blockChange && commandChange && restored && unusedBytes)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje otisk (fingerprint) paměti grafické karty a command bufferu.
+  Otisk se používá pro přeskočení kreslení, pokud se od minulého snímku nic nezměnilo.
+  Stejný stav musí mít stejný otisk a změna uniformní proměnné, uniformního bloku
+  nebo příkazu musí otisk změnit. Nepoužité bajty příkazů otisk měnit nesmí.)." << std::endl;
+  if(!stable       )std::cerr << "  Otisk stejného stavu není stejný." << std::endl;
+  if(!uniformChange)std::cerr << "  Změna uniformní proměnné nezměnila otisk." << std::endl;
+  if(!blockChange  )std::cerr << "  Změna uniformního bloku nezměnila otisk." << std::endl;
+  if(!commandChange)std::cerr << "  Změna příkazu nezměnila otisk." << std::endl;
+  if(!restored     )std::cerr << "  Návrat do původního stavu nevrátil původní otisk." << std::endl;
+  if(!unusedBytes  )std::cerr << "  Nepoužité bajty příkazu změnily otisk." << std::endl;
+  REQUIRE(false);
+}
+
+glm::vec4 const zPrepassPositions[] = {
+  glm::vec4(-1.f,-1.f,+.5f,1.f),glm::vec4(+3.f,-1.f,+.5f,1.f),glm::vec4(-1.f,+3.f,+.5f,1.f),
+  glm::vec4(-1.f,-1.f,-.2f,1.f),glm::vec4(+3.f,-1.f,-.2f,1.f),glm::vec4(-1.f,+3.f,-.2f,1.f),
+  glm::vec4(-1.f,-1.f,+.1f,1.f),glm::vec4(+3.f,-1.f,+.1f,1.f),glm::vec4(-1.f,+3.f,+.1f,1.f),
+  glm::vec4(-1.f,-1.f,-.5f,1.f),glm::vec4(+3.f,-1.f,-.5f,1.f),glm::vec4(-1.f,+3.f,-.5f,1.f),
+};
+
+glm::vec4 const zPrepassColors[] = {
+  glm::vec4(1.f,0.f,0.f,1.f),
+  glm::vec4(0.f,1.f,0.f,1.f),
+  glm::vec4(0.f,0.f,1.f,1.f),
+  glm::vec4(1.f,1.f,1.f,1.f),
+};
+
+void vertexShaderZPrepass(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
+  outVertex.gl_Position        = zPrepassPositions[inVertex.gl_VertexID];
+  outVertex.attributes[0].v4   = zPrepassColors   [inVertex.gl_VertexID/3];
+}
+
+uint32_t countedFragments = 0;
+void fragmentShaderZPrepass(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&){
+  countedFragments++;
+  outFragment.gl_FragColor = inFragment.attributes[0].v4;
+}
+
+// last draw of the execution mode scene, it is the nearest one
+enum class LastDraw{NONE,DEPTH_ONLY,TRANSLUCENT};
+
+uint32_t renderExecutionModeScene(ExecutionMode mode,LastDraw last,std::vector<uint8_t>&color,std::vector<float>&depth){
+  uint32_t const w = 10;
+  uint32_t const h = 10;
+  MEMCB();
+  auto framebuffer = std::make_shared<Framebuffer>(w,h);
+  mem.framebuffer = framebuffer->getFrame();
+  // forward runs are the reference, hierarchical depth buffer would reject hidden triangles
+  if(mode == ExecutionMode::FORWARD)mem.framebuffer.hiZ = nullptr;
+  mem.programs[0].vertexShader   = vertexShaderZPrepass  ;
+  mem.programs[0].fragmentShader = fragmentShaderZPrepass;
+  mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+
+  // every triangle has its own part of index buffer
+  std::vector<uint32_t>indices = {0,1,2,3,4,5,6,7,8,9,10,11};
+  mem.buffers[0] = vectorToBuffer(indices);
+  VertexArray vao;
+  vao.indexBufferID = 0;
+  vao.indexType     = IndexType::UINT32;
+
+  cb.executionMode = mode;
+  pushClearCommand(cb,glm::vec4(0.f,0.f,0.f,1.f));
+  for(uint32_t i=0;i<3;++i){
+    vao.indexOffset = sizeof(uint32_t)*3*i;
+    pushDrawCommand(cb,3,0,vao);
+    cb.commands[cb.nofCommands-1].data.drawCommand.opaque = true;
+  }
+  if(last != LastDraw::NONE){
+    vao.indexOffset = sizeof(uint32_t)*9;
+    pushDrawCommand(cb,3,0,vao);
+    cb.commands[cb.nofCommands-1].data.drawCommand.depthOnly = last == LastDraw::DEPTH_ONLY;
+  }
+
+  countedFragments = 0;
+  gpu_execute(mem,cb);
+
+  color.assign(mem.framebuffer.color,mem.framebuffer.color+w*h*mem.framebuffer.channels);
+  depth.assign(mem.framebuffer.depth,mem.framebuffer.depth+w*h);
+  return countedFragments;
+}
+
+// interpolated colors are not exact, blending of almost opaque fragments can differ by one
+bool sameColor(std::vector<uint8_t>const&a,std::vector<uint8_t>const&b){
+  return a.size() == b.size() && std::equal(a.begin(),a.end(),b.begin(),[](uint8_t x,uint8_t y){return glm::abs((int)x-(int)y) <= 1;});
+}
+
+SCENARIO("53"){
+  std::cerr << "53 - depth only draws and Z-prepass execution mode" << std::endl;
+
+  uint32_t const w = 10;
+  uint32_t const h = 10;
+
+  std::vector<uint8_t>forwardColor,prepassColor,depthOnlyColor;
+  std::vector<float  >forwardDepth,prepassDepth,depthOnlyDepth;
+
+  auto forwardFragments   = renderExecutionModeScene(ExecutionMode::FORWARD  ,LastDraw::NONE      ,forwardColor  ,forwardDepth  );
+  auto prepassFragments   = renderExecutionModeScene(ExecutionMode::Z_PREPASS,LastDraw::NONE      ,prepassColor  ,prepassDepth  );
+  auto depthOnlyFragments = renderExecutionModeScene(ExecutionMode::FORWARD  ,LastDraw::DEPTH_ONLY,depthOnlyColor,depthOnlyDepth);
+
+  bool const sameImage     = sameColor(forwardColor,prepassColor) && forwardDepth == prepassDepth;
+  bool const oneFragment   = forwardFragments == 3*w*h && prepassFragments == w*h;
+  bool const depthOnly     = depthOnlyFragments == forwardFragments && depthOnlyColor == forwardColor &&
+    std::all_of(depthOnlyDepth.begin(),depthOnlyDepth.end(),[](float d){return glm::abs(d-.25f) < 1e-6f;});
+
+  if(sameImage && oneFragment && depthOnly)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kreslí tři neprůhledné trojúhelníky přes celou obrazovku v různých hloubkách.
+  V režimu ExecutionMode::Z_PREPASS se nejdříve zapíše hloubka neprůhledných kreslení
+  a potom se fragment shader spustí jen pro viditelné fragmenty (hloubka je rovna uložené hloubce).
+  Výsledný obrázek musí být stejný jako v režimu ExecutionMode::FORWARD.
+  Kreslení s depthOnly = true zapisuje jen hloubku a nespouští fragment shader.)." << std::endl;
+  if(!sameImage  )std::cerr << "  Obrázek se Z-prepass se liší od obrázku bez Z-prepass." << std::endl;
+  if(!oneFragment)std::cerr << "  Fragment shader se spustil "<<forwardFragments<<"x bez Z-prepass (očekáváno "<<3*w*h<<"x) a "<<prepassFragments<<"x se Z-prepass (očekáváno "<<w*h<<"x)." << std::endl;
+  if(!depthOnly  )std::cerr << "  Kreslení s depthOnly spustilo fragment shader, změnilo barvu nebo nezapsalo hloubku." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("54"){
+  std::cerr << "54 - visibility buffer execution mode" << std::endl;
+
+  uint32_t const w = 10;
+  uint32_t const h = 10;
+
+  std::vector<uint8_t>forwardColor,visibilityColor,forwardTranslucentColor,visibilityTranslucentColor,depthOnlyColor;
+  std::vector<float  >forwardDepth,visibilityDepth,forwardTranslucentDepth,visibilityTranslucentDepth,depthOnlyDepth;
+
+  auto forwardFragments               = renderExecutionModeScene(ExecutionMode::FORWARD          ,LastDraw::NONE       ,forwardColor              ,forwardDepth              );
+  auto visibilityFragments            = renderExecutionModeScene(ExecutionMode::VISIBILITY_BUFFER,LastDraw::NONE       ,visibilityColor           ,visibilityDepth           );
+  auto forwardTranslucentFragments    = renderExecutionModeScene(ExecutionMode::FORWARD          ,LastDraw::TRANSLUCENT,forwardTranslucentColor   ,forwardTranslucentDepth   );
+  auto visibilityTranslucentFragments = renderExecutionModeScene(ExecutionMode::VISIBILITY_BUFFER,LastDraw::TRANSLUCENT,visibilityTranslucentColor,visibilityTranslucentDepth);
+  auto depthOnlyFragments             = renderExecutionModeScene(ExecutionMode::VISIBILITY_BUFFER,LastDraw::DEPTH_ONLY ,depthOnlyColor            ,depthOnlyDepth            );
+
+  bool const sameImage   = sameColor(forwardColor           ,visibilityColor           ) && forwardDepth            == visibilityDepth           ;
+  bool const translucent = sameColor(forwardTranslucentColor,visibilityTranslucentColor) && forwardTranslucentDepth == visibilityTranslucentDepth;
+  bool const oneFragment = forwardFragments == 3*w*h && visibilityFragments == w*h &&
+    forwardTranslucentFragments == 4*w*h && visibilityTranslucentFragments == 2*w*h;
+  bool const depthOnly   = depthOnlyFragments == 0 &&
+    std::all_of(depthOnlyDepth.begin(),depthOnlyDepth.end(),[](float d){return glm::abs(d-.25f) < 1e-6f;});
+
+  if(sameImage && translucent && oneFragment && depthOnly)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kreslí tři neprůhledné trojúhelníky přes celou obrazovku v různých hloubkách.
+  V režimu ExecutionMode::VISIBILITY_BUFFER rasterizace neprůhledných kreslení zapisuje jen hloubku
+  a viditelný trojúhelník pixelu. Fragment shader se potom spustí jednou pro každý pixel.
+  Kreslení, která nejsou neprůhledná, se stínují až potom.
+  Výsledný obrázek musí být stejný jako v režimu ExecutionMode::FORWARD.)." << std::endl;
+  if(!sameImage  )std::cerr << "  Obrázek s visibility bufferem se liší od obrázku bez visibility bufferu." << std::endl;
+  if(!translucent)std::cerr << "  Obrázek s průhledným kreslením se s visibility bufferem liší." << std::endl;
+  if(!oneFragment)std::cerr << "  Fragment shader se spustil "<<visibilityFragments<<"x (očekáváno "<<w*h<<"x) a s průhledným kreslením "<<visibilityTranslucentFragments<<"x (očekáváno "<<2*w*h<<"x)." << std::endl;
+  if(!depthOnly  )std::cerr << "  Kreslení s depthOnly zakrylo neprůhledné trojúhelníky, ty se ale přesto stínovaly." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("55"){
+  std::cerr << "55 - hierarchical depth buffer rejects hidden triangles" << std::endl;
+
+  uint32_t const w = 20;
+  uint32_t const h = 20;
+
+  auto render = [&](bool useHiZ,std::vector<uint8_t>&color,std::vector<float>&depth){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(w,h);
+    mem.framebuffer = framebuffer->getFrame();
+    if(!useHiZ)mem.framebuffer.hiZ = nullptr;
+    mem.programs[0].vertexShader   = vertexShaderZPrepass  ;
+    mem.programs[0].fragmentShader = fragmentShaderZPrepass;
+    mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+
+    // near triangle is drawn first, farther triangles behind it are hidden
+    std::vector<uint32_t>indices = {3,4,5,0,1,2,6,7,8};
+    mem.buffers[0] = vectorToBuffer(indices);
+    VertexArray vao;
+    vao.indexBufferID = 0;
+    vao.indexType     = IndexType::UINT32;
+
+    pushClearCommand(cb,glm::vec4(0.f,0.f,0.f,1.f));
+    pushDrawCommand (cb,9,0,vao);
+
+    countedFragments = 0;
+    gpu_execute(mem,cb);
+
+    color.assign(mem.framebuffer.color,mem.framebuffer.color+w*h*mem.framebuffer.channels);
+    depth.assign(mem.framebuffer.depth,mem.framebuffer.depth+w*h);
+    return countedFragments;
+  };
+
+  std::vector<uint8_t>hiZColor,referenceColor;
+  std::vector<float  >hiZDepth,referenceDepth;
+
+  auto hiZFragments       = render(true ,hiZColor      ,hiZDepth      );
+  auto referenceFragments = render(false,referenceColor,referenceDepth);
+
+  bool const sameImage = hiZColor == referenceColor && hiZDepth == referenceDepth;
+  bool const rejected  = hiZFragments == w*h && referenceFragments == 3*w*h;
+
+  if(sameImage && rejected)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kreslí trojúhelník přes celou obrazovku a za něj dva další trojúhelníky.
+  Hierarchický hloubkový buffer (Frame::hiZ) drží maximální hloubku každé dlaždice )."<<hiZTileSize<<"x"<<hiZTileSize<<R".( pixelů.
+  Trojúhelník, jehož nejbližší hloubka je dál než maximální hloubka dlaždice, se v dlaždici nerasterizuje.
+  Obrázek musí být stejný jako bez hierarchického hloubkového bufferu.)." << std::endl;
+  if(!sameImage)std::cerr << "  Obrázek s hierarchickým hloubkovým bufferem se liší." << std::endl;
+  if(!rejected )std::cerr << "  Fragment shader se spustil "<<hiZFragments<<"x (očekáváno "<<w*h<<"x)." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("56"){
+  std::cerr << "56 - occlusion queries count samples that passed depth test" << std::endl;
+
+  uint32_t const w = 20;
+  uint32_t const h = 20;
+
+  auto render = [&](ExecutionMode mode){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(w,h);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderZPrepass  ;
+    mem.programs[0].fragmentShader = fragmentShaderZPrepass;
+    mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+
+    // near, far and nearest triangle
+    std::vector<uint32_t>indices = {3,4,5,0,1,2,9,10,11};
+    mem.buffers[0] = vectorToBuffer(indices);
+    VertexArray vao;
+    vao.indexBufferID = 0;
+    vao.indexType     = IndexType::UINT32;
+
+    cb.executionMode = mode;
+    pushClearCommand(cb,glm::vec4(0.f,0.f,0.f,1.f));
+    for(uint32_t i=0;i<3;++i){
+      vao.indexOffset = sizeof(uint32_t)*3*i;
+      pushBeginQueryCommand(cb,i);
+      pushDrawCommand(cb,3,0,vao);
+      cb.commands[cb.nofCommands-1].data.drawCommand.opaque = true;
+      pushEndQueryCommand(cb);
+    }
+    // draw outside of query is not counted
+    vao.indexOffset = 0;
+    pushDrawCommand(cb,3,0,vao);
+
+    gpu_execute(mem,cb);
+    return std::vector<uint64_t>{mem.queries[0],mem.queries[1],mem.queries[2]};
+  };
+
+  std::vector<uint64_t>const expected = {w*h,0,w*h};
+
+  auto forward    = render(ExecutionMode::FORWARD          );
+  auto prepass    = render(ExecutionMode::Z_PREPASS        );
+  auto visibility = render(ExecutionMode::VISIBILITY_BUFFER);
+
+  if(forward == expected && prepass == expected && visibility == expected)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test zkouší okluzní dotazy (CommandType::BEGIN_QUERY a CommandType::END_QUERY).
+  Fragmenty, které mezi nimi projdou hloubkovým testem, se počítají do mem.queries[queryID].
+  Kreslí se blízký trojúhelník přes celou obrazovku, vzdálený trojúhelník za ním
+  a nejbližší trojúhelník před nimi, každý ve vlastním dotazu.
+  Očekávané výsledky jsou: )."<<expected[0]<<", "<<expected[1]<<", "<<expected[2]<<std::endl;
+  auto print = [](char const*name,std::vector<uint64_t>const&r){
+    std::cerr << "  " << name << ": " << r[0] << ", " << r[1] << ", " << r[2] << std::endl;
+  };
+  print("ExecutionMode::FORWARD          ",forward   );
+  print("ExecutionMode::Z_PREPASS        ",prepass   );
+  print("ExecutionMode::VISIBILITY_BUFFER",visibility);
+  REQUIRE(false);
+}
+
+void vertexShaderFullscreen(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
+  glm::vec2 const positions[] = {glm::vec2(-1.f,-1.f),glm::vec2(+3.f,-1.f),glm::vec2(-1.f,+3.f)};
+  outVertex.gl_Position = glm::vec4(positions[inVertex.gl_VertexID%3],0.f,1.f);
+}
+
+void fragmentShaderUniformColor(OutFragment&outFragment,InFragment const&,ShaderInterface const&si){
+  outFragment.gl_FragColor = si.uniforms[0].v4;
+}
+
+SCENARIO("58"){
+  std::cerr << "58 - blend modes" << std::endl;
+
+  auto const frameColor = glm::vec4(.5f,.3f,.2f,1.f);
+  auto const fragColor  = glm::vec4(.3f,.4f,.2f,.3f);
+
+  auto render = [&](BlendMode mode,float&depth){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(4,4);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderFullscreen    ;
+    mem.programs[0].fragmentShader = fragmentShaderUniformColor;
+    mem.uniforms[0].v4             = fragColor;
+
+    pushClearCommand(cb,frameColor,1.f);
+    pushDrawCommand (cb,3);
+    cb.commands[1].data.drawCommand.blendMode = mode;
+
+    gpu_execute(mem,cb);
+
+    depth = mem.framebuffer.depth[5];
+    return glm::uvec4(mem.framebuffer.color[5*4+0],mem.framebuffer.color[5*4+1],mem.framebuffer.color[5*4+2],mem.framebuffer.color[5*4+3]);
+  };
+
+  auto expected = [&](float srcFactor,float dstFactor){
+    auto dst = glm::vec3(glm::uvec3(glm::vec3(frameColor)*255.f))/255.f;
+    return glm::uvec4(glm::uvec3(glm::clamp(dst*dstFactor+glm::vec3(fragColor)*srcFactor,0.f,1.f)*255.f),glm::uint(fragColor.a*255.f));
+  };
+
+  float alphaDepth,offDepth,additiveDepth,premultipliedDepth;
+  auto alpha         = render(BlendMode::ALPHA        ,alphaDepth        );
+  auto off           = render(BlendMode::OFF          ,offDepth          );
+  auto additive      = render(BlendMode::ADDITIVE     ,additiveDepth     );
+  auto premultiplied = render(BlendMode::PREMULTIPLIED,premultipliedDepth);
+
+  auto const expectedAlpha         = expected(fragColor.a,1.f-fragColor.a);
+  auto const expectedOff           = glm::uvec4(fragColor*255.f);
+  auto const expectedAdditive      = expected(fragColor.a,1.f            );
+  auto const expectedPremultiplied = expected(1.f        ,1.f-fragColor.a);
+
+  bool const colors = alpha == expectedAlpha && off == expectedOff && additive == expectedAdditive && premultiplied == expectedPremultiplied;
+  // blended fragment with alpha <= 0.5 does not write depth, fragment without blending does
+  bool const depths = alphaDepth == 1.f && offDepth != 1.f;
+
+  if(colors && depths)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje blendovací módy kreslících příkazů (DrawCommand::blendMode).
+  Barva framebufferu: )."<<str(frameColor)<<R".(, barva fragmentu: )."<<str(fragColor)<<R".(
+  BlendMode::ALPHA         - src*a + dst*(1-a)
+  BlendMode::OFF           - src, framebuffer se nečte a hloubka se zapíše vždy
+  BlendMode::ADDITIVE      - src*a + dst
+  BlendMode::PREMULTIPLIED - src + dst*(1-a))." << std::endl;
+  std::cerr << "  ALPHA        : " << str(alpha        ) << " očekáváno: " << str(expectedAlpha        ) << std::endl;
+  std::cerr << "  OFF          : " << str(off          ) << " očekáváno: " << str(expectedOff          ) << std::endl;
+  std::cerr << "  ADDITIVE     : " << str(additive     ) << " očekáváno: " << str(expectedAdditive     ) << std::endl;
+  std::cerr << "  PREMULTIPLIED: " << str(premultiplied) << " očekáváno: " << str(expectedPremultiplied) << std::endl;
+  if(!depths)std::cerr << "  Hloubka se nezapsala správně (ALPHA: " << alphaDepth << ", OFF: " << offDepth << ")." << std::endl;
+  REQUIRE(false);
+}
+
+void vertexShaderCorner(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
+  glm::vec2 const positions[] = {glm::vec2(-1.f,-1.f),glm::vec2(-.7f,-1.f),glm::vec2(-1.f,-.7f)};
+  outVertex.gl_Position = glm::vec4(positions[inVertex.gl_VertexID%3],0.f,1.f);
+}
+
+SCENARIO("59"){
+  std::cerr << "59 - fast clear" << std::endl;
+
+  auto const clearColor = glm::vec4(.2f,.4f,.6f,1.f);
+  auto const fragColor  = glm::vec4(.9f,.1f,.3f,1.f);
+
+  auto render = [&](std::shared_ptr<Framebuffer>const&framebuffer,bool fast){
+    MEMCB();
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderCorner        ;
+    mem.programs[0].fragmentShader = fragmentShaderUniformColor;
+    mem.uniforms[0].v4             = fragColor;
+
+    pushClearCommand(cb,clearColor,1.f);
+    cb.commands[0].data.clearCommand.fast = fast;
+    pushDrawCommand (cb,3);
+
+    gpu_execute(mem,cb);
+    return mem.framebuffer;
+  };
+
+  auto eager = std::make_shared<Framebuffer>(20,20);
+  auto lazy  = std::make_shared<Framebuffer>(20,20);
+  render(eager,false);
+  auto frame = render(lazy,true);
+
+  // tile of the triangle is filled on the first touch, untouched tiles are filled by gpu_resolve
+  auto const touched   = readColor(frame,glm::uvec2(7 ,7 )) == glm::uvec3(floatColorToBytes(clearColor));
+  auto const untouched = readColor(frame,glm::uvec2(19,19)) == glm::uvec3(0);
+  gpu_resolve(frame);
+  auto const resolved  = lazy->color == eager->color && lazy->depth == eager->depth;
+
+  if(touched && untouched && resolved)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje rychlé čistění (ClearCommand::fast).
+  Rychlé čistění pouze označí dlaždice framebufferu jako vyčištěné.
+  Dlaždice se vyplní barvou a hloubkou při prvním kreslení do ní nebo funkcí gpu_resolve.
+  Po gpu_resolve musí být framebuffer stejný jako po obyčejném čistění.)." << std::endl;
+  if(!touched  )std::cerr << "  Dlaždice s trojúhelníkem nebyla vyplněna při prvním kreslení." << std::endl;
+  if(!untouched)std::cerr << "  Dlaždice bez kreslení byla vyplněna už před gpu_resolve." << std::endl;
+  if(!resolved )std::cerr << "  Framebuffer po gpu_resolve se liší od obyčejného čistění." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("68"){
+  std::cerr << "68 - packed RGBA8 color writes saturate and truncate" << std::endl;
+
+  // channels outside [0,1], values just below byte boundaries and exact bytes
+  std::vector<glm::vec4>const colors = {
+    glm::vec4(-.5f ,1.5f      ,.5f      ,2.f  ),
+    glm::vec4(.2f  ,254.5f/255,1.f/255  ,-1e9f),
+    glm::vec4(1e9f ,0.f       ,.999999f ,.7f  ),
+  };
+  auto const frameColor = glm::vec4(.5f,.3f,.2f,1.f);
+
+  // only clear is rendered if there is no blend mode
+  auto render = [&](glm::vec4 const&clearColor,glm::vec4 const&fragColor,BlendMode const*mode){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(4,4);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderFullscreen    ;
+    mem.programs[0].fragmentShader = fragmentShaderUniformColor;
+    mem.uniforms[0].v4             = fragColor;
+
+    pushClearCommand(cb,clearColor,1.f);
+    if(mode){
+      pushDrawCommand(cb,3);
+      cb.commands[1].data.drawCommand.blendMode = *mode;
+    }
+
+    gpu_execute(mem,cb);
+    return glm::uvec4(mem.framebuffer.color[5*4+0],mem.framebuffer.color[5*4+1],mem.framebuffer.color[5*4+2],mem.framebuffer.color[5*4+3]);
+  };
+
+  // scalar reference: clamp to [0,1] and truncate like (uint8_t)(c*255.f)
+  auto pack = [](glm::vec4 const&c){
+    return glm::uvec4(glm::clamp(c,0.f,1.f)*255.f);
+  };
+
+  BlendMode const off   = BlendMode::OFF  ;
+  BlendMode const alpha = BlendMode::ALPHA;
+
+  bool success = true;
+  for(auto const&c:colors){
+    auto const cleared  = render(c         ,c,nullptr);
+    auto const written  = render(frameColor,c,&off   );
+    auto const blended  = render(frameColor,c,&alpha );
+    auto const dst      = glm::vec4(pack(frameColor))/255.f;
+    auto const expected = glm::uvec4(glm::uvec3(glm::clamp(dst*(1.f-c.a)+c*c.a,0.f,1.f)*255.f),pack(c).a);
+    if(cleared == pack(c) && written == pack(c) && blended == expected)continue;
+    success = false;
+    std::cerr << "  barva: " << str(c) << std::endl;
+    std::cerr << "    čistění  : " << str(cleared) << " očekáváno: " << str(pack(c)) << std::endl;
+    std::cerr << "    OFF      : " << str(written) << " očekáváno: " << str(pack(c)) << std::endl;
+    std::cerr << "    ALPHA    : " << str(blended) << " očekáváno: " << str(expected) << std::endl;
+  }
+
+  if(success)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje zápis barvy do framebufferu jako jednoho 32 bitového pixelu RGBA8.
+  Kanály se oříznou do intervalu [0,1] a převedou na bajty jako (uint8_t)(c*255.f),
+  SSE2 i skalární verze musí dávat stejné bajty jako tento vzorec i pro hodnoty mimo interval.)." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("60"){
+  std::cerr << "60 - tiled frame layout" << std::endl;
+
+  uint32_t const width  = 21;
+  uint32_t const height = 13;
+
+  auto render = [&](std::shared_ptr<Framebuffer>const&framebuffer,std::vector<uint8_t>&color,std::vector<float>&depth){
+    MEMCB();
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderCorner        ;
+    mem.programs[0].fragmentShader = fragmentShaderUniformColor;
+    mem.uniforms[0].v4             = glm::vec4(.9f,.1f,.3f,1.f);
+
+    pushClearCommand(cb,glm::vec4(.2f,.4f,.6f,1.f),1.f);
+    //tiles of tiled frame are filled by fast clear
+    cb.commands[0].data.clearCommand.fast = framebuffer->layout == FrameLayout::TILED;
+    pushDrawCommand (cb,3);
+
+    gpu_execute(mem,cb);
+    gpu_resolve(mem.framebuffer);
+    color.resize(width*height*4);
+    depth.resize(width*height);
+    gpu_readFrame(mem.framebuffer,color.data(),depth.data());
+  };
+
+  std::vector<uint8_t>linearColor,tiledColor;
+  std::vector<float  >linearDepth,tiledDepth;
+  render(std::make_shared<Framebuffer>(width,height,FrameLayout::LINEAR),linearColor,linearDepth);
+  render(std::make_shared<Framebuffer>(width,height,FrameLayout::TILED ),tiledColor ,tiledDepth );
+
+  if(linearColor == tiledColor && linearDepth == tiledDepth)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje framebuffer uložený po dlaždicích (FrameLayout::TILED).
+  Dlaždice hiZTileSize x hiZTileSize pixelů jsou v paměti za sebou, framebuffer se čte funkcí gpu_readFrame.
+  Vykreslený snímek se liší od snímku ve framebufferu uloženém po řádcích.)." << std::endl;
+  REQUIRE(false);
+}
+
+void vertexShaderDepthLayer(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&si){
+  glm::vec2 const positions[] = {glm::vec2(-1.f,-1.f),glm::vec2(+3.f,-1.f),glm::vec2(-1.f,+3.f)};
+  outVertex.gl_Position = glm::vec4(positions[inVertex.gl_VertexID%3],si.uniforms[2+inVertex.gl_DrawID].v1,1.f);
+  outVertex.attributes[0].v4 = si.uniforms[inVertex.gl_DrawID].v4;
+}
+
+void fragmentShaderAttributeColor(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&){
+  outFragment.gl_FragColor = inFragment.attributes[0].v4;
+}
+
+SCENARIO("61"){
+  std::cerr << "61 - depth formats" << std::endl;
+
+  auto const nearColor = glm::vec4(1.f,0.f,0.f,1.f);
+  auto const farColor  = glm::vec4(0.f,1.f,0.f,1.f);
+  // window depth of the second layer is farther by 2e-6, it is less than step of 16-bit depth but more than step of 24-bit depth
+  float const nearZ = 0.f;
+  float const farZ  = 4e-6f;
+
+  auto render = [&](DepthFormat format,glm::uvec3&color,float&depth){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(4,4);
+    framebuffer->depthFormat = format;
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderDepthLayer      ;
+    mem.programs[0].fragmentShader = fragmentShaderAttributeColor;
+    mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+    mem.uniforms[0].v4 = nearColor;
+    mem.uniforms[1].v4 = farColor ;
+    mem.uniforms[2].v1 = nearZ    ;
+    mem.uniforms[3].v1 = farZ     ;
+
+    pushClearCommand(cb,glm::vec4(0.f),1.f);
+    pushDrawCommand (cb,3);
+    pushDrawCommand (cb,3);
+    cb.commands[1].data.drawCommand.blendMode = BlendMode::OFF;
+    cb.commands[2].data.drawCommand.blendMode = BlendMode::OFF;
+
+    gpu_execute(mem,cb);
+
+    std::vector<uint8_t>c(4*4*4);
+    std::vector<float  >d(4*4);
+    gpu_readFrame(mem.framebuffer,c.data(),d.data());
+    color = glm::uvec3(c[5*4+0],c[5*4+1],c[5*4+2]);
+    depth = d[5];
+  };
+
+  glm::uvec3 floatColor,unorm16Color,unorm24Color;
+  float floatDepth,unorm16Depth,unorm24Depth;
+  render(DepthFormat::FLOAT32,floatColor  ,floatDepth  );
+  render(DepthFormat::UNORM16,unorm16Color,unorm16Depth);
+  render(DepthFormat::UNORM24,unorm24Color,unorm24Depth);
+
+  auto const nearBytes = glm::uvec3(floatColorToBytes(nearColor));
+  auto const farBytes  = glm::uvec3(floatColorToBytes(farColor ));
+  bool const colors = floatColor == nearBytes && unorm24Color == nearBytes && unorm16Color == farBytes;
+  bool const depths = std::abs(floatDepth-.5f) < 1e-6f && std::abs(unorm16Depth-.5f) <= 1.f/65535.f && std::abs(unorm24Depth-.5f) <= 1.f/16777215.f+1e-7f;
+
+  if(colors && depths)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje formáty hloubkového bufferu (Frame::depthFormat).
+  Celočíselné formáty ukládají hloubku z intervalu [0, 1], hloubka fragmentu se kvantuje a hloubkový test porovnává celá čísla.
+  Dva trojúhelníky přes celou obrazovku se liší hloubkou o 2e-6, což je méně než krok 16 bitové hloubky, ale více než krok 24 bitové hloubky.
+  Druhý (vzdálenější) trojúhelník tak projde hloubkovým testem jen v DepthFormat::UNORM16.)." << std::endl;
+  std::cerr << "  FLOAT32: barva " << str(floatColor  ) << " hloubka " << floatDepth   << std::endl;
+  std::cerr << "  UNORM16: barva " << str(unorm16Color) << " hloubka " << unorm16Depth << std::endl;
+  std::cerr << "  UNORM24: barva " << str(unorm24Color) << " hloubka " << unorm24Depth << std::endl;
+  REQUIRE(false);
+}
+
+uint32_t multisampleShadedFragments = 0;
+
+void vertexShaderHalfScreen(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
+  //right edge goes through the middle of pixel column 4 of 8 pixels wide frame
+  glm::vec2 const positions[] = {glm::vec2(-3.f,-1.f),glm::vec2(.125f,-1.f),glm::vec2(.125f,3.f)};
+  outVertex.gl_Position = glm::vec4(positions[inVertex.gl_VertexID%3],0.f,1.f);
+}
+
+void fragmentShaderCountedWhite(OutFragment&outFragment,InFragment const&,ShaderInterface const&){
+  multisampleShadedFragments++;
+  outFragment.gl_FragColor = glm::vec4(1.f);
+}
+
+SCENARIO("62"){
+  std::cerr << "62 - 4x multisampling" << std::endl;
+
+  auto render = [&](ExecutionMode mode,uint32_t&shaded){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(8,8,FrameLayout::LINEAR,4);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderHalfScreen    ;
+    mem.programs[0].fragmentShader = fragmentShaderCountedWhite;
+
+    pushClearCommand(cb,glm::vec4(0.f,0.f,0.f,1.f),1.f);
+    pushDrawCommand (cb,3);
+    cb.commands[1].data.drawCommand.opaque    = true;
+    cb.commands[1].data.drawCommand.blendMode = BlendMode::OFF;
+    cb.executionMode = mode;
+
+    multisampleShadedFragments = 0;
+    gpu_execute(mem,cb);
+    gpu_resolve(mem.framebuffer);
+    shaded = multisampleShadedFragments;
+
+    return std::vector<glm::uvec3>{readColor(mem.framebuffer,glm::uvec2(3,4)),readColor(mem.framebuffer,glm::uvec2(4,4)),readColor(mem.framebuffer,glm::uvec2(5,4))};
+  };
+
+  uint32_t forwardShaded,visibilityShaded;
+  auto forward    = render(ExecutionMode::FORWARD          ,forwardShaded   );
+  auto visibility = render(ExecutionMode::VISIBILITY_BUFFER,visibilityShaded);
+
+  // 2 of 4 samples of the edge pixel are covered, fragment shader runs once per covered pixel (5 columns of 8 rows)
+  auto const expected = std::vector<glm::uvec3>{glm::uvec3(255),glm::uvec3(128),glm::uvec3(0)};
+  bool const colors = forward == expected && visibility == expected;
+  bool const shading = forwardShaded == 5*8 && visibilityShaded == 5*8;
+
+  if(colors && shading)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje 4x multisampling (Frame::samples).
+  Pokrytí a hloubka se počítají ve 4 vzorcích pixelu, fragment shader se spustí jednou na pixel a výsledná barva se zapíše do pokrytých vzorků.
+  gpu_resolve zprůměruje vzorky do barvy pixelu.
+  Bílý trojúhelník pokrývá sloupce 0 - 3 celé a polovinu vzorků sloupce 4.)." << std::endl;
+  std::cerr << "  barvy sloupců 3, 4, 5 (FORWARD)          : " << str(forward   [0]) << " " << str(forward   [1]) << " " << str(forward   [2]) << std::endl;
+  std::cerr << "  barvy sloupců 3, 4, 5 (VISIBILITY_BUFFER): " << str(visibility[0]) << " " << str(visibility[1]) << " " << str(visibility[2]) << std::endl;
+  std::cerr << "  očekáváno                                : " << str(expected  [0]) << " " << str(expected  [1]) << " " << str(expected  [2]) << std::endl;
+  std::cerr << "  počet spuštění fragment shaderu: " << forwardShaded << ", " << visibilityShaded << " očekáváno: " << 5*8 << std::endl;
+  REQUIRE(false);
+}
+
+void fragmentShaderGBuffer(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&){
+  outFragment.gl_FragColor   = inFragment.attributes[0].v4;
+  outFragment.gl_FragData[0] = inFragment.attributes[0].v4;
+  outFragment.gl_FragData[1] = glm::vec4(-.5f,.25f,1.f,0.f);
+  outFragment.gl_FragData[2] = glm::vec4(glm::vec3(inFragment.gl_FragCoord),1.f);
+}
+
+SCENARIO("63"){
+  std::cerr << "63 - multiple render targets" << std::endl;
+
+  MEMCB();
+  auto framebuffer = std::make_shared<Framebuffer>(4,4);
+  framebuffer->addAttachment(0,ColorFormat::RGBA8  );
+  framebuffer->addAttachment(1,ColorFormat::RGBA16F);
+  framebuffer->addAttachment(2,ColorFormat::RGBA32F);
+  mem.framebuffer = framebuffer->getFrame();
+  mem.programs[0].vertexShader   = vertexShaderDepthLayer;
+  mem.programs[0].fragmentShader = fragmentShaderGBuffer ;
+  mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+  // near layer is drawn first, far layer fails depth test and must not overwrite attachments
+  mem.uniforms[0].v4 = glm::vec4(1.f,.5f,0.f,1.f);
+  mem.uniforms[1].v4 = glm::vec4(0.f,0.f,1.f,1.f);
+  mem.uniforms[2].v1 = -.5f;
+  mem.uniforms[3].v1 = +.5f;
+
+  pushClearCommand(cb,glm::vec4(0.f),1.f);
+  pushDrawCommand (cb,3);
+  pushDrawCommand (cb,3);
+  cb.commands[1].data.drawCommand.blendMode = BlendMode::OFF;
+  cb.commands[2].data.drawCommand.blendMode = BlendMode::OFF;
+
+  gpu_execute(mem,cb);
+
+  uint32_t const pix = 5;
+  auto const albedo = glm::uvec4(
+      framebuffer->attachmentData[0][pix*4+0],framebuffer->attachmentData[0][pix*4+1],
+      framebuffer->attachmentData[0][pix*4+2],framebuffer->attachmentData[0][pix*4+3]);
+  uint64_t packedNormal;
+  memcpy(&packedNormal,framebuffer->attachmentData[1].data()+pix*8,sizeof(packedNormal));
+  auto const normal = glm::unpackHalf4x16(packedNormal);
+  glm::vec4 position;
+  memcpy(&position,framebuffer->attachmentData[2].data()+pix*16,sizeof(position));
+
+  bool const albedoOk   = albedo == floatColorToBytes(mem.uniforms[0].v4);
+  bool const normalOk   = normal == glm::vec4(-.5f,.25f,1.f,0.f);
+  bool const positionOk = position.x == 1.5f && position.y == 1.5f && std::abs(position.z-.25f) < 1e-6f && position.w == 1.f;
+
+  if(albedoOk && normalOk && positionOk)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje zápis fragment shaderu do více barevných příloh (OutFragment::gl_FragData, Frame::attachments).
+  Přílohy mají formáty RGBA8, RGBA16F a RGBA32F a zapisují se bez blendingu fragmenty, které projdou hloubkovým testem.
+  Bližší vrstva se kreslí první, vzdálenější vrstva nesmí přílohy přepsat.)." << std::endl;
+  std::cerr << "  RGBA8  : " << str(albedo  ) << " očekáváno: " << str(floatColorToBytes(mem.uniforms[0].v4)) << std::endl;
+  std::cerr << "  RGBA16F: " << str(normal  ) << " očekáváno: " << str(glm::vec4(-.5f,.25f,1.f,0.f)) << std::endl;
+  std::cerr << "  RGBA32F: " << str(position) << " očekáváno: " << str(glm::vec4(1.5f,1.5f,.25f,1.f)) << std::endl;
+  REQUIRE(false);
+}
+
+void fragmentShaderFrameTextures(OutFragment&outFragment,InFragment const&inFragment,ShaderInterface const&si){
+  auto const uv    = glm::vec2(inFragment.gl_FragCoord)/glm::vec2(si.textures[0].width,si.textures[0].height);
+  auto const color = read_texture(si.textures[0],uv);
+  auto const depth = read_texture(si.textures[1],uv);
+  outFragment.gl_FragColor = glm::vec4(glm::vec3(color),depth.r);
+}
+
+SCENARIO("64"){
+  std::cerr << "64 - render to texture" << std::endl;
+
+  MEMCB();
+  auto framebuffer = std::make_shared<Framebuffer>(8,8);
+  mem.framebuffer = framebuffer->getFrame();
+  auto target = std::make_shared<Framebuffer>(8,8,FrameLayout::TILED);
+  target->depthFormat = DepthFormat::UNORM16;
+  mem.frames[0] = target->getFrame();
+  mem.textures[0] = frameColorTexture(mem.frames[0]);
+  mem.textures[1] = frameDepthTexture(mem.frames[0]);
+
+  // first pass renders layer to the target, second pass copies color and depth of the target to the framebuffer
+  mem.programs[0].vertexShader   = vertexShaderDepthLayer      ;
+  mem.programs[0].fragmentShader = fragmentShaderAttributeColor;
+  mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+  mem.programs[1].vertexShader   = vertexShaderFullscreen      ;
+  mem.programs[1].fragmentShader = fragmentShaderFrameTextures ;
+  mem.uniforms[0].v4 = glm::vec4(.2f,.4f,.6f,1.f);
+  mem.uniforms[2].v1 = -.5f;
+
+  pushBindFramebufferCommand(cb,0);
+  pushClearCommand          (cb,glm::vec4(0.f),1.f);
+  pushDrawCommand           (cb,3);
+  pushBindFramebufferCommand(cb);
+  pushClearCommand          (cb,glm::vec4(0.f),1.f);
+  pushDrawCommand           (cb,3,1);
+  cb.commands[5].data.drawCommand.blendMode = BlendMode::OFF;
+
+  gpu_execute(mem,cb);
+
+  auto const expected = floatColorToBytes(glm::vec4(.2f,.4f,.6f,.25f));
+  bool success = true;
+  for(uint32_t i=0;i<8*8;++i){
+    auto const color = glm::ivec4(framebuffer->color[i*4+0],framebuffer->color[i*4+1],framebuffer->color[i*4+2],framebuffer->color[i*4+3]);
+    success &= glm::all(glm::lessThanEqual(glm::abs(color-glm::ivec4(expected)),glm::ivec4(1)));
+  }
+
+  if(success)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje kreslení do textury (BindFramebufferCommand, GPUMemory::frames).
+  První průchod kreslí do snímku mem.frames[0] (FrameLayout::TILED, DepthFormat::UNORM16) s hloubkou 0.25.
+  Druhý průchod kreslí do mem.framebuffer a fragment shader čte barvu a hloubku prvního snímku
+  přes textury frameColorTexture a frameDepthTexture.
+  Výsledná barva má obsahovat barvu prvního průchodu a v alfa kanálu jeho hloubku.)." << std::endl;
+  std::cerr << "  barva pixelu 0: " << str(glm::uvec4(framebuffer->color[0],framebuffer->color[1],framebuffer->color[2],framebuffer->color[3])) << " očekáváno: " << str(expected) << std::endl;
+  REQUIRE(false);
+}
+
+void vertexShaderSlanted(OutVertex&outVertex,InVertex const&inVertex,ShaderInterface const&){
+  glm::vec2 const positions[] = {glm::vec2(-.9f,-.8f),glm::vec2(+.8f,-.3f),glm::vec2(-.4f,+.9f)};
+  outVertex.gl_Position = glm::vec4(positions[inVertex.gl_VertexID%3],0.f,1.f);
+}
+
+SCENARIO("65"){
+  std::cerr << "65 - post process FXAA" << std::endl;
+
+  uint32_t const size = 32;
+  // frame is filtered by different numbers of bands, halo rows make the results identical
+  auto render = [&](FrameLayout layout,uint32_t nofThreads){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(size,size,layout);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderSlanted      ;
+    mem.programs[0].fragmentShader = fragmentShaderUniformColor;
+    mem.uniforms[0].v4 = glm::vec4(1.f);
+    pushClearCommand(cb,glm::vec4(0.f,0.f,0.f,1.f));
+    pushDrawCommand (cb,3);
+    gpu_execute(mem,cb);
+    gpu_resolve(mem.framebuffer);
+    std::vector<uint8_t>color(size*size*4);
+    gpu_readFrame(mem.framebuffer,color.data(),nullptr);
+    postProcess(mem.framebuffer,fxaaFilter(),nofThreads);
+    std::vector<uint8_t>filtered(size*size*4);
+    gpu_readFrame(mem.framebuffer,filtered.data(),nullptr);
+    return std::make_pair(color,filtered);
+  };
+
+  auto const single = render(FrameLayout::LINEAR,1);
+  auto const banded = render(FrameLayout::LINEAR,4);
+  auto const tiled  = render(FrameLayout::TILED ,3);
+
+  uint32_t smoothed = 0;
+  bool     flatKept = true;
+  for(uint32_t i=0;i<size*size;++i){
+    auto const before = single.first [i*4];
+    auto const after  = single.second[i*4];
+    if(after != before && after != 0 && after != 255)++smoothed;
+    // right corners are far from the triangle
+    if(i%size >= size-4 && (i/size < 4 || i/size >= size-4) && (before != 0 || after != 0))flatKept = false;
+  }
+  bool const bandsOk = single.second == banded.second && single.second == tiled.second;
+
+  if(smoothed > 0 && flatKept && bandsOk)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje post process filtr FXAA (postProcess, fxaaFilter).
+  Bílý trojúhelník se šikmými hranami na černém pozadí je vyhlazen filtrem FXAA.
+  Pixely na hranách mají získat mezilehlé hodnoty, pixely daleko od hran se nemají změnit.
+  Snímek se filtruje po pásech řádků ve více vláknech, pásy čtou okolní řádky (PostProcessFilter::radius),
+  výsledek proto nesmí záviset na počtu vláken ani na rozložení snímku (FrameLayout).)." << std::endl;
+  std::cerr << "  vyhlazených pixelů: " << smoothed << std::endl;
+  std::cerr << "  pozadí beze změny : " << str(flatKept) << std::endl;
+  std::cerr << "  shoda pásů        : " << str(bandsOk ) << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("66"){
+  std::cerr << "66 - weighted blended order independent transparency" << std::endl;
+
+  auto const nearColor = glm::vec4(1.f,0.f,0.f,.5f);
+  auto const farColor  = glm::vec4(0.f,1.f,0.f,.5f);
+  auto render = [&](bool nearFirst,ExecutionMode mode,float&depth){
+    MEMCB();
+    auto framebuffer = std::make_shared<Framebuffer>(4,4);
+    mem.framebuffer = framebuffer->getFrame();
+    mem.programs[0].vertexShader   = vertexShaderDepthLayer      ;
+    mem.programs[0].fragmentShader = fragmentShaderAttributeColor;
+    mem.programs[0].vs2fs[0]       = AttributeType::VEC4;
+    mem.uniforms[0].v4 = nearFirst ? nearColor : farColor ;
+    mem.uniforms[1].v4 = nearFirst ? farColor  : nearColor;
+    mem.uniforms[2].v1 = nearFirst ? -.2f : +.2f;
+    mem.uniforms[3].v1 = nearFirst ? +.2f : -.2f;
+    cb.executionMode = mode;
+    pushClearCommand(cb,glm::vec4(0.f,0.f,1.f,1.f),1.f);
+    pushDrawCommand (cb,3);
+    pushDrawCommand (cb,3);
+    cb.commands[1].data.drawCommand.blendMode = BlendMode::WEIGHTED;
+    cb.commands[2].data.drawCommand.blendMode = BlendMode::WEIGHTED;
+    gpu_execute(mem,cb);
+    depth = framebuffer->depth[5];
+    return glm::ivec4(framebuffer->color[5*4+0],framebuffer->color[5*4+1],framebuffer->color[5*4+2],framebuffer->color[5*4+3]);
+  };
+
+  float nearFirstDepth,farFirstDepth,visibilityDepth;
+  auto const nearFirst  = render(true ,ExecutionMode::FORWARD          ,nearFirstDepth );
+  auto const farFirst   = render(false,ExecutionMode::FORWARD          ,farFirstDepth  );
+  auto const visibility = render(false,ExecutionMode::VISIBILITY_BUFFER,visibilityDepth);
+
+  // both layers together cover 1 - 0.5 * 0.5 of the background, the nearer layer has higher weight
+  bool const orderOk    = glm::all(glm::lessThanEqual(glm::abs(nearFirst-farFirst),glm::ivec4(1))) && nearFirst == visibility;
+  bool const revealOk   = std::abs(nearFirst.b - 64) <= 1;
+  bool const weightOk   = nearFirst.r > nearFirst.g && nearFirst.g > 0;
+  bool const depthOk    = nearFirstDepth == 1.f && farFirstDepth == 1.f && visibilityDepth == 1.f;
+
+  if(orderOk && revealOk && weightOk && depthOk)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje průhlednost nezávislou na pořadí (BlendMode::WEIGHTED).
+  Dvě poloprůhledné vrstvy (červená blíž, zelená dál, alfa 0.5) se kreslí přes modré pozadí v obou pořadích.
+  Fragmenty se sčítají s vahou podle alfy a hloubky a násobí se jejich propustnost (1 - alfa),
+  výsledek se složí s pozadím až po všech kreslících příkazech. Výsledek nesmí záviset na pořadí,
+  z pozadí má zůstat 0.25, bližší vrstva má větší váhu a fragmenty nezapisují hloubku.)." << std::endl;
+  std::cerr << "  bližší první      : " << str(glm::uvec4(nearFirst )) << " hloubka " << nearFirstDepth  << std::endl;
+  std::cerr << "  vzdálenější první : " << str(glm::uvec4(farFirst  )) << " hloubka " << farFirstDepth   << std::endl;
+  std::cerr << "  visibility buffer : " << str(glm::uvec4(visibility)) << " hloubka " << visibilityDepth << std::endl;
+  REQUIRE(false);
+}
+
+void fragmentShaderCheckedUniform(OutFragment&outFragment,InFragment const&,ShaderInterface const&si){
+  // texture 0 of the empty table is sampled through the raw array, like examples did before they used si.texture
+  outFragment.gl_FragColor = si.uniform(0).v4 + si.uniform(7).v4 + glm::vec4(si.texture(3).width) + read_texture(si.textures[0],glm::vec2(.5f));
+}
+
+SCENARIO("67"){
+  std::cerr << "67 - shaders read resources that were never written" << std::endl;
+
+  MEMCB();
+  auto framebuffer = std::make_shared<Framebuffer>(4,4);
+  mem.framebuffer = framebuffer->getFrame();
+  mem.programs[0].vertexShader   = vertexShaderFullscreen      ;
+  mem.programs[0].fragmentShader = fragmentShaderCheckedUniform;
+  mem.uniforms[0].v4 = glm::vec4(.2f,.4f,.6f,1.f);
+
+  pushClearCommand(cb,glm::vec4(0.f));
+  pushDrawCommand (cb,3);
+  cb.commands[1].data.drawCommand.blendMode = BlendMode::OFF;
+
+  gpu_execute(mem,cb);
+
+  // default uniform is identity matrix, its first column is added
+  auto const expected = floatColorToBytes(glm::min(mem.uniforms[0].v4 + Uniform().v4,1.f));
+  auto const color    = glm::uvec4(framebuffer->color[0],framebuffer->color[1],framebuffer->color[2],framebuffer->color[3]);
+  bool const colorOk  = color == expected;
+  bool const tablesOk = mem.uniforms.size() == 1 && mem.textures.size() == 0 && mem.programs.size() == 1;
+
+  if(colorOk && tablesOk)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje čtení zdrojů, které nebyly nikdy zapsány.
+  Shader čte uniformní proměnnou 7 a texturu 3 přes ShaderInterface::uniform a ShaderInterface::texture,
+  ty vrací výchozí hodnoty. Texturu 0 prázdné tabulky čte přímo přes si.textures[0],
+  ukazatel prázdné tabulky musí ukazovat na výchozí texturu. gpu_execute čte tabulky GPUMemory jen pro čtení a nesmí je zvětšit.)." << std::endl;
+  std::cerr << "  barva: " << str(color) << " očekáváno: " << str(expected) << std::endl;
+  std::cerr << "  velikosti tabulek uniforms/textures/programs: " << mem.uniforms.size() << "/" << mem.textures.size() << "/" << mem.programs.size() << std::endl;
+  REQUIRE(false);
+}
+
+struct DefaultedBlock{
+  glm::mat4 matrix    = glm::mat4(1.f);
+  int32_t   textureID = -1            ;
+};
+
+SCENARIO("69"){
+  std::cerr << "69 - new uniform blocks are default constructed" << std::endl;
+
+  UniformBuffer buffer;
+  buffer.block<DefaultedBlock>(2).textureID = 3;
+  buffer.block<DefaultedBlock>(5);
+
+  auto isDefault = [&](uint32_t i){
+    auto const&b = buffer.block<DefaultedBlock>(i);
+    return b.matrix == glm::mat4(1.f) && b.textureID == -1;
+  };
+
+  bool const sizeOk    = buffer.nofBlocks() == 6 && buffer.stride == sizeof(DefaultedBlock);
+  bool const defaultOk = isDefault(0) && isDefault(1) && isDefault(3) && isDefault(4) && isDefault(5);
+  bool const writtenOk = buffer.block<DefaultedBlock>(2).textureID == 3 && buffer.block<DefaultedBlock>(2).matrix == glm::mat4(1.f);
+
+  if(sizeOk && defaultOk && writtenOk)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje růst uniformního bufferu.
+  Nové bloky vytvořené přes UniformBuffer::block<T> musí mít výchozí hodnoty členů T
+  (jednotková matice, textureID = -1), ne nuly. Zapsaný blok musí zůstat zachován i po zvětšení bufferu.)." << std::endl;
+  std::cerr << "  počet bloků: " << buffer.nofBlocks() << " očekáváno: 6, stride: " << buffer.stride << " očekáváno: " << sizeof(DefaultedBlock) << std::endl;
+  REQUIRE(false);
+}
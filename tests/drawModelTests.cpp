@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string.h>
+#include <sstream>
 
 #include <catch2/catch_test_macros.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -114,3 +115,205 @@ SCENARIO("39"){
   checkModelMemory(model,Diff::INV_MATRIX);
 }
 
+
+OutVertex runModelVertexShader(GPUMemory const&mem,DrawCommand const&cmd,InVertex const&inVertex){
+  auto const&prg = mem.programs[cmd.programID];
+
+  ShaderInterface si;
+  si.uniforms     = mem.uniforms.data();
+  si.textures     = mem.textures.data();
+  si.uniformBlock = mem.uniformBuffers[cmd.uniformBufferID].blockData(cmd.uniformBlock);
+
+  Uniform constants[maxConstants];
+  if(prg.prologue){
+    prg.prologue(constants,si);
+    si.constants = constants;
+  }
+
+  OutVertex outVertex;
+  prg.vertexShader(outVertex,inVertex,si);
+  return outVertex;
+}
+
+bool areModelVerticesSame(MemCb const&expected,MemCb const&student){
+  if(expected.cb.nofCommands != student.cb.nofCommands)return false;
+  for(uint32_t i=1;i<expected.cb.nofCommands;++i){
+    auto const&ecmd = expected.cb.commands[i].data.drawCommand;
+    auto const&scmd = student .cb.commands[i].data.drawCommand;
+    auto eIns = computeExpectedInVertices(expected.mem,ecmd);
+    auto sIns = computeExpectedInVertices(student .mem,scmd);
+    if(eIns.size() != sIns.size())return false;
+    for(size_t v=0;v<eIns.size();++v){
+      auto eOut = runModelVertexShader(expected.mem,ecmd,eIns[v]);
+      auto sOut = runModelVertexShader(student .mem,scmd,sIns[v]);
+      if(!equalVec4(eOut.gl_Position     ,sOut.gl_Position     ))return false;
+      if(!equalVec3(eOut.attributes[0].v3,sOut.attributes[0].v3))return false;
+      if(!equalVec3(eOut.attributes[1].v3,sOut.attributes[1].v3))return false;
+    }
+  }
+  return true;
+}
+
+SCENARIO("51"){
+  std::cerr << "51 - prepareModel - model cache with baked world space vertices" << std::endl;
+
+  std::vector<float>vertices = {
+    0.f,0.f,0.f, 0.f,0.f,1.f,
+    1.f,0.f,0.f, 0.f,1.f,1.f,
+    0.f,1.f,0.f, 1.f,0.f,1.f,
+    1.f,1.f,0.f, 0.f,0.f,1.f,
+  };
+  std::vector<uint16_t>indices = {0,1,2,2,1,3};
+
+  Model model;
+  model.buffers.push_back(vectorToBuffer(vertices));
+  model.buffers.push_back(vectorToBuffer(indices ));
+
+  Mesh mesh;
+  mesh.position = {0,sizeof(float)*6,0              ,AttributeType::VEC3};
+  mesh.normal   = {0,sizeof(float)*6,sizeof(float)*3,AttributeType::VEC3};
+  mesh.nofIndices = 3;
+  model.meshes.push_back(mesh);
+
+  mesh.indexBufferID = 1;
+  mesh.indexType     = IndexType::UINT16;
+  mesh.nofIndices    = (uint32_t)indices.size();
+  model.meshes.push_back(mesh);
+
+  Node child;
+  child.mesh        = 1;
+  child.modelMatrix = glm::rotate(glm::mat4(1.f),0.3f,glm::vec3(0.f,1.f,0.f));
+  Node root;
+  root.mesh        = 0;
+  root.modelMatrix = glm::scale(glm::translate(glm::mat4(1.f),glm::vec3(1.f,2.f,3.f)),glm::vec3(2.f,-1.f,.5f));
+  root.children.push_back(child);
+  model.roots.push_back(root);
+
+  auto viewProjection = glm::perspective(glm::radians(60.f),1.f,1.f,100.f)*glm::lookAt(glm::vec3(10.f,5.f,-8.f),glm::vec3(0.f),glm::vec3(0.f,1.f,0.f));
+
+  auto expected = createMemCb();
+  auto student  = createMemCb();
+  ModelCache cache;
+
+  prepareModel(expected->mem,expected->cb,model      );
+  prepareModel(student ->mem,student ->cb,model,cache);
+  expected->mem.uniforms[0].m4 = viewProjection;
+  student ->mem.uniforms[0].m4 = viewProjection;
+
+  bool baked = student->cb.commands[1].data.drawCommand.programID == 1 && student->cb.commands[2].data.drawCommand.programID == 1;
+  bool same  = areModelVerticesSame(*expected,*student);
+
+  model.roots[0].children[0].modelMatrix = glm::translate(glm::mat4(1.f),glm::vec3(0.f,-3.f,1.f));
+  updateModelCache(student->mem,model,cache);
+
+  expected = createMemCb();
+  prepareModel(expected->mem,expected->cb,model);
+  expected->mem.uniforms[0].m4 = viewProjection;
+
+  bool sameAfterUpdate = areModelVerticesSame(*expected,*student);
+
+  // preparing the model again reuses baked buffers
+  auto nofBuffers = student->mem.buffers.size();
+  prepareModel(student->mem,student->cb,model,cache);
+  bool buffersReused = student->mem.buffers.size() == nofBuffers;
+
+  if(baked && same && sameAfterUpdate && buffersReused)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje cache modelu (ModelCache).
+  prepareModel s cache by měl předpočítat pozice a normály ve world space do bufferů
+  a kreslící příkazy by měly použít program 1, který vrcholy pouze promítne.
+  Výstup vertex shaderu musí být stejný jako bez cache.
+  Po změně matice uzlu musí updateModelCache vrcholy přepočítat.)." << std::endl;
+  if(!baked          )std::cerr << "  Kreslící příkazy nepoužívají předpočítané vrcholy (program 1)." << std::endl;
+  if(!same           )std::cerr << "  Výstup vertex shaderu s cache se liší od výstupu bez cache." << std::endl;
+  if(!sameAfterUpdate)std::cerr << "  Po změně matice uzlu se výstup vertex shaderu s cache liší od výstupu bez cache." << std::endl;
+  if(!buffersReused  )std::cerr << "  Opakované prepareModel se stejnou cache přidává nové buffery místo použití předpočítaných." << std::endl;
+  REQUIRE(false);
+}
+
+SCENARIO("57"){
+  std::cerr << "57 - sortDraws - opaque draws front to back, others back to front" << std::endl;
+
+  std::vector<float>vertices = {
+    -1.f,-1.f,0.f,
+    +1.f,-1.f,0.f,
+    -1.f,+1.f,0.f,
+  };
+
+  Model model;
+  model.buffers.push_back(vectorToBuffer(vertices));
+
+  Mesh mesh;
+  mesh.position   = {0,sizeof(float)*3,0,AttributeType::VEC3};
+  mesh.nofIndices = 3;
+  mesh.opaque     = true;
+  model.meshes.push_back(mesh);
+  mesh.opaque     = false;
+  model.meshes.push_back(mesh);
+
+  // mesh and distance from camera of every node
+  std::vector<std::pair<int32_t,float>>nodes = {{0,10.f},{1,3.f},{0,2.f},{1,8.f},{0,6.f}};
+  for(auto const&n:nodes){
+    Node node;
+    node.mesh        = n.first;
+    node.modelMatrix = glm::translate(glm::mat4(1.f),glm::vec3(0.f,0.f,-n.second));
+    model.roots.push_back(node);
+  }
+
+  auto memCb = createMemCb();
+  auto&mem = memCb->mem;
+  auto&cb  = memCb->cb ;
+  DrawSorter sorter;
+  auto firstDraw = prepareModel(mem,cb,model);
+  prepareDrawSorter(mem,firstDraw,model,sorter);
+
+  // commands changed after prepareDrawSorter have to be kept by sorting
+  for(uint32_t i=firstDraw;i<cb.nofCommands;++i)
+    cb.commands[i].data.drawCommand.programID = cb.commands[i].data.drawCommand.uniformBlock+1;
+
+  auto order = [&](){
+    std::vector<uint32_t>res;
+    for(uint32_t i=1;i<cb.nofCommands;++i)
+      res.push_back(cb.commands[i].data.drawCommand.uniformBlock);
+    return res;
+  };
+
+  sortDraws(mem,cb,sorter,glm::mat4(1.f));
+  auto front = order();
+
+  // camera behind the nodes looking back
+  sortDraws(mem,cb,sorter,glm::lookAt(glm::vec3(0.f,0.f,-20.f),glm::vec3(0.f),glm::vec3(0.f,1.f,0.f)));
+  auto back = order();
+
+  std::vector<uint32_t>const expectedFront = {2,4,0,3,1};
+  std::vector<uint32_t>const expectedBack  = {0,4,2,1,3};
+
+  bool const clearKept = cb.commands[0].type == CommandType::CLEAR && cb.nofCommands == 6;
+
+  bool commandsKept = true;
+  for(uint32_t i=firstDraw;i<cb.nofCommands;++i)
+    commandsKept &= cb.commands[i].data.drawCommand.programID == cb.commands[i].data.drawCommand.uniformBlock+1;
+
+  if(front == expectedFront && back == expectedBack && clearKept && commandsKept)return;
+
+  auto str = [](std::vector<uint32_t>const&v){
+    std::stringstream ss;
+    for(auto const&x:v)ss << x << " ";
+    return ss.str();
+  };
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje řazení kreslících příkazů podle hloubky (sortDraws).
+  Neprůhledná kreslení mají být seřazena od nejbližšího k nejvzdálenějšímu,
+  ostatní kreslení až za nimi od nejvzdálenějšího k nejbližšímu.
+  Čistící příkaz musí zůstat první.
+  Řazení musí přeházet aktuální příkazy, změny provedené po prepareDrawSorter se nesmí ztratit.)." << std::endl;
+  std::cerr << "  Pořadí bloků (kamera v počátku): " << str(front) << " očekáváno: " << str(expectedFront) << std::endl;
+  std::cerr << "  Pořadí bloků (kamera za modelem): " << str(back ) << " očekáváno: " << str(expectedBack ) << std::endl;
+  REQUIRE(false);
+}
@@ -92,7 +92,7 @@ void insertBuffersMentionedInCommandBufferToBufferTypes(std::map<uint32_t,Buffer
 }
 
 void appendBuffersNotMentionedInCommandBufferToBufferTypes(std::map<uint32_t,BufferType>&bufferTypes,GPUMemory const&mem){
-  for(uint32_t i=0;i<mem.maxBuffers;++i){
+  for(uint32_t i=0;i<mem.buffers.size();++i){
     if(!mem.buffers[i].data)continue;
     if(bufferTypes.count(i))continue;
     insertTypeToBufferTypes(bufferTypes,i,BufferType::MIXED);
@@ -142,7 +142,7 @@ std::string gpuMemFramebufferToString(size_t p,GPUMemory const&mem){
 
 std::string gpuMemProgramsToString(size_t p,GPUMemory const&mem){
   std::stringstream ss;
-  for(uint32_t i=0;i<mem.maxPrograms;++i){
+  for(uint32_t i=0;i<mem.programs.size();++i){
     if(mem.programs[i].vertexShader){
       ss << padding(p) << "mem.programs["<<i<<"].vertexShader   = function;"<< std::endl;
       ss << padding(p) << "mem.programs["<<i<<"].fragmentShader = function;"<< std::endl;
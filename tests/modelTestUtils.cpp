@@ -14,14 +14,6 @@
 
 namespace tests::model{
 
-uint32_t drawCallUniforms(uint32_t drawId){
-  return drawCallUniformOffset + drawId*drawCallNofUniforms;
-}
-
-uint32_t uniformIdToDrawCallUniform(uint32_t uId){
-  return (uId - drawCallUniformOffset) % drawCallNofUniforms;
-}
-
 void nodes(
     GPUMemory    &mem,
     CommandBuffer&commandBuffer,
@@ -42,20 +34,16 @@ void nodes(
     vao.vertexAttrib[2] = mesh.texCoord;
     bool doubleSided    = !mesh.doubleSided;
 
-    pushDrawCommand(commandBuffer,mesh.nofIndices,0,vao,doubleSided);
+    pushDrawCommand(commandBuffer,mesh.nofIndices,0,vao,doubleSided,1,Topology::TRIANGLES,drawCallUniformBuffer,cmdID);
 
-    auto&modelMatrixUniform        = mem.uniforms[drawCallUniforms(cmdID)+MODEL       ].m4;
-    auto&inverseModelMatrixUniform = mem.uniforms[drawCallUniforms(cmdID)+INV_MODEL   ].m4;
-    auto&diffuseColorUniform       = mem.uniforms[drawCallUniforms(cmdID)+DIFF_COLOR  ].v4;
-    auto&diffuseTextureIDUniform   = mem.uniforms[drawCallUniforms(cmdID)+TEXTURE_ID  ].u1;
-    auto&doubleSidedUniform        = mem.uniforms[drawCallUniforms(cmdID)+DOUBLE_SIDED].v1;
+    auto const nodeMatrix = modelMatrix*node.modelMatrix;
 
-    diffuseColorUniform       = mesh.diffuseColor;
-    doubleSidedUniform        = (float)mesh.doubleSided;
-    diffuseTextureIDUniform   = mesh.diffuseTexture;
-    //isTextureUniform          = mesh.diffuseTexture<0?0.f:1.f;
-    modelMatrixUniform        = modelMatrix*node.modelMatrix;
-    inverseModelMatrixUniform = glm::transpose(glm::inverse(modelMatrixUniform));
+    auto&u = mem.uniformBuffers[drawCallUniformBuffer].block<DrawModelUniforms>(cmdID);
+    u.diffuseColor      = mesh.diffuseColor;
+    u.doubleSided       = (float)mesh.doubleSided;
+    u.textureID         = mesh.diffuseTexture;
+    u.model             = nodeMatrix;
+    u.invTransposeModel = glm::transpose(glm::inverse(nodeMatrix));
 
     cmdID++;
   }
@@ -76,6 +64,7 @@ TranslatedModel getExpectedTranslatedModel(Model const&model){
 
   mem.programs[0].vertexShader   = drawModel_vertexShader;
   mem.programs[0].fragmentShader = drawModel_fragmentShader;
+  mem.programs[0].prologue       = drawModel_prologue;
   mem.programs[0].vs2fs[0] = AttributeType::VEC3;
   mem.programs[0].vs2fs[1] = AttributeType::VEC3;
   mem.programs[0].vs2fs[2] = AttributeType::VEC2;
@@ -138,27 +127,30 @@ Diff areTranslatedModelsSame(
       for(uint32_t a=0;a<maxAttributes;++a)
         if(!(ecc.vao.vertexAttrib[a] == scc.vao.vertexAttrib[a]))
           return filterErrorLevel(Diff::ATTRIB,level);
+      if(ecc.uniformBufferID   != scc.uniformBufferID  )return filterErrorLevel(Diff::UNIFORM_BLOCK,level);
+      if(ecc.uniformBlock      != scc.uniformBlock     )return filterErrorLevel(Diff::UNIFORM_BLOCK,level);
 
     }
   }
 
-  for(uint32_t i=0;i<GPUMemory::maxPrograms;++i){
+  for(uint32_t i=0;i<std::max(emem.programs.size(),smem.programs.size());++i){
     auto const&ep = emem.programs[i];
     auto const&sp = smem.programs[i];
     if(ep.vertexShader   != sp.vertexShader  )return filterErrorLevel(Diff::SHADERS,level);
     if(ep.fragmentShader != sp.fragmentShader)return filterErrorLevel(Diff::SHADERS,level);
+    if(ep.prologue       != sp.prologue      )return filterErrorLevel(Diff::SHADERS,level);
     for(uint32_t a=0;a<maxAttributes;++a)
       if(ep.vs2fs[a] != sp.vs2fs[a])return filterErrorLevel(Diff::VS2FS,level);
   }
 
-  for(uint32_t i=0;i<GPUMemory::maxBuffers;++i){
+  for(uint32_t i=0;i<std::max(emem.buffers.size(),smem.buffers.size());++i){
     auto const&eb = emem.buffers[i];
     auto const&sb = smem.buffers[i];
     if(eb.data != sb.data)return filterErrorLevel(Diff::BUFFERS,level);
     if(eb.size != sb.size)return filterErrorLevel(Diff::BUFFERS,level);
   }
 
-  for(uint32_t i=0;i<GPUMemory::maxTextures;++i){
+  for(uint32_t i=0;i<std::max(emem.textures.size(),smem.textures.size());++i){
     auto const&et = emem.textures[i];
     auto const&st = smem.textures[i];
     if(et.data     != st.data    )return filterErrorLevel(Diff::TEXTURES,level);
@@ -167,28 +159,22 @@ Diff areTranslatedModelsSame(
     if(et.width    != st.width   )return filterErrorLevel(Diff::TEXTURES,level);
   }
 
-  for(uint32_t i=0;i<GPUMemory::maxUniforms;++i){
-    auto const&eu = emem.uniforms[i];
-    auto const&su = smem.uniforms[i];
-    if(i<drawCallUniformOffset){
-      if(!isGeneralUniformSame(eu,su))return filterErrorLevel(Diff::INV_MATRIX,level);
-    }else{
-      auto di = uniformIdToDrawCallUniform(i);
-      if(di == DrawCallUniform::DIFF_COLOR){
-        if(eu.v4 != su.v4)return filterErrorLevel(Diff::DIFFUSE_COLOR,level);
-      }
-      if(di == DrawCallUniform::DOUBLE_SIDED){
-        if(eu.v1 != su.v1)return filterErrorLevel(Diff::DOUBLE_SIDED,level);
-      }
-      if(di == DrawCallUniform::TEXTURE_ID){
-        if(eu.i1 != su.i1)return filterErrorLevel(Diff::TEXTURE_ID,level);
-      }
-      if(di == DrawCallUniform::MODEL){
-        if(eu.m4 != su.m4)return filterErrorLevel(Diff::MODEL_MATRIX,level);
-      }
-      if(di == DrawCallUniform::INV_MODEL){
-        if(eu.m4 != su.m4)return filterErrorLevel(Diff::INV_MATRIX,level);
-      }
+  for(uint32_t i=0;i<std::max(emem.uniforms.size(),smem.uniforms.size());++i)
+    if(!isGeneralUniformSame(emem.uniforms[i],smem.uniforms[i]))return filterErrorLevel(Diff::INV_MATRIX,level);
+
+  for(uint32_t i=0;i<std::max(emem.uniformBuffers.size(),smem.uniformBuffers.size());++i){
+    auto const&eb = emem.uniformBuffers[i];
+    auto const&sb = smem.uniformBuffers[i];
+    if(eb.stride      != sb.stride     )return filterErrorLevel(Diff::TEXTURE_ID,level);
+    if(eb.nofBlocks() != sb.nofBlocks())return filterErrorLevel(Diff::TEXTURE_ID,level);
+    for(uint32_t b=0;b<eb.nofBlocks();++b){
+      auto const&eu = *(DrawModelUniforms const*)eb.blockData(b);
+      auto const&su = *(DrawModelUniforms const*)sb.blockData(b);
+      if(eu.textureID         != su.textureID        )return filterErrorLevel(Diff::TEXTURE_ID   ,level);
+      if(eu.doubleSided       != su.doubleSided      )return filterErrorLevel(Diff::DOUBLE_SIDED ,level);
+      if(eu.diffuseColor      != su.diffuseColor     )return filterErrorLevel(Diff::DIFFUSE_COLOR,level);
+      if(eu.model             != su.model            )return filterErrorLevel(Diff::MODEL_MATRIX ,level);
+      if(eu.invTransposeModel != su.invTransposeModel)return filterErrorLevel(Diff::INV_MATRIX   ,level);
     }
   }
 
@@ -259,6 +245,10 @@ std::string listDrawProps(size_t p,uint32_t i,DrawCommand const&cc,Diff const&pr
       ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.vao.vertexAttrib["<<a<<"].type     = " << str(aa.type    ) << std::endl;
     }
   }
+  if(prop == Diff::UNIFORM_BLOCK){
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.uniformBufferID = " << str(cc.uniformBufferID) << std::endl;
+    ss << padding(p) << "cb.commands["<<i<<"].data.drawCommand.uniformBlock    = " << str(cc.uniformBlock   ) << std::endl;
+  }
   return ss.str();
 }
 
@@ -273,13 +263,15 @@ std::string listCommandBufferProp(size_t p,CommandBuffer const&cb,Diff const&pro
 
 std::string listShaders(size_t p,GPUMemory const&mem){
   std::stringstream ss;
-  for(uint32_t i=0;i<GPUMemory::maxPrograms;++i){
+  for(uint32_t i=0;i<mem.programs.size();++i){
     auto const&prg = mem.programs[i];
     auto const&vs  = prg.vertexShader  ;
     auto const&fs  = prg.fragmentShader;
-    if(vs || fs ){
+    auto const&pr  = prg.prologue      ;
+    if(vs || fs || pr){
       if(vs)ss << padding(p) << "mem.programs["<<i<<"].vertexShader   = " << vs << ";" << std::endl;
       if(fs)ss << padding(p) << "mem.programs["<<i<<"].fragmentShader = " << fs << ";" << std::endl;
+      if(pr)ss << padding(p) << "mem.programs["<<i<<"].prologue       = " << pr << ";" << std::endl;
     }
   }
   return ss.str();
@@ -287,7 +279,7 @@ std::string listShaders(size_t p,GPUMemory const&mem){
 
 std::string listVS2FS(size_t p,GPUMemory const&mem){
   std::stringstream ss;
-  for(uint32_t i=0;i<GPUMemory::maxPrograms;++i){
+  for(uint32_t i=0;i<mem.programs.size();++i){
     auto const&v = mem.programs[i].vs2fs;
     for(uint32_t a=0;a<maxAttributes;++a){
       if(v[a] == AttributeType::EMPTY)continue;
@@ -299,7 +291,7 @@ std::string listVS2FS(size_t p,GPUMemory const&mem){
 
 std::string listBuffers(size_t p,GPUMemory const&mem){
   std::stringstream ss;
-  for(uint32_t i=0;i<GPUMemory::maxBuffers;++i){
+  for(uint32_t i=0;i<mem.buffers.size();++i){
     auto const&b = mem.buffers[i];
     if(!b.data)continue;
     ss << padding(p) << "mem.buffers["<<i<<"].data = " << b.data << ";" << std::endl;
@@ -310,7 +302,7 @@ std::string listBuffers(size_t p,GPUMemory const&mem){
 
 std::string listTextures(size_t p,GPUMemory const&mem){
   std::stringstream ss;
-  for(uint32_t i=0;i<GPUMemory::maxTextures;++i){
+  for(uint32_t i=0;i<mem.textures.size();++i){
     auto const&t = mem.textures[i];
     if(!t.data)continue;
     ss << padding(p) << "mem.textures["<<i<<"].data     = " << t.data     << ";" << std::endl;
@@ -356,25 +348,28 @@ UniformType determineUniformType(Uniform const&u){
   return UniformType::V4;
 }
 
-std::string listUniforms(size_t p,GPUMemory const&mem,DrawCallUniform uType){
+std::string listUniforms(size_t p,GPUMemory const&mem,Diff const&prop){
   std::stringstream ss;
-  for(uint32_t i=0;i<GPUMemory::maxUniforms;++i){
+  for(uint32_t i=0;i<mem.uniforms.size();++i){
     auto const&u=mem.uniforms[i];
     if(u.m4 == glm::mat4(1.f))continue;
-    UniformType type;
-    std::string uniformName;
-    if(i<drawCallUniformOffset){
-      type = determineUniformType(u);
-    }else{
-      auto mtype = uniformIdToDrawCallUniform(i);
-      if(mtype != uType)continue;
-      if(mtype == DrawCallUniform::MODEL       ){type = UniformType::M4;uniformName = "modelMatrix"       ;}
-      if(mtype == DrawCallUniform::INV_MODEL   ){type = UniformType::M4;uniformName = "inverseModelMatrix";}
-      if(mtype == DrawCallUniform::DIFF_COLOR  ){type = UniformType::V4;uniformName = "diffuseColor"      ;}
-      if(mtype == DrawCallUniform::TEXTURE_ID  ){type = UniformType::I1;uniformName = "textureID"         ;}
-      if(mtype == DrawCallUniform::DOUBLE_SIDED){type = UniformType::V1;uniformName = "doubleSided"       ;}
+    ss << padding(p) << "mem.uniforms["<<i<<"]."<<uniformToStr(u,determineUniformType(u))<<";"<<std::endl;
+  }
+  for(uint32_t i=0;i<mem.uniformBuffers.size();++i){
+    auto const&b = mem.uniformBuffers[i];
+    if(b.stride != sizeof(DrawModelUniforms)){
+      if(b.stride)ss << padding(p) << "mem.uniformBuffers["<<i<<"].stride = " << b.stride << "; // sizeof(DrawModelUniforms) = " << sizeof(DrawModelUniforms) << std::endl;
+      continue;
+    }
+    for(uint32_t j=0;j<b.nofBlocks();++j){
+      auto const&u = *(DrawModelUniforms const*)b.blockData(j);
+      std::string block = "mem.uniformBuffers["+str(i)+"].block<DrawModelUniforms>("+str(j)+").";
+      if(prop == Diff::MODEL_MATRIX )ss << padding(p) << block << "model             = " << str(u.model            ) << ";" << std::endl;
+      if(prop == Diff::INV_MATRIX   )ss << padding(p) << block << "invTransposeModel = " << str(u.invTransposeModel) << ";" << std::endl;
+      if(prop == Diff::DIFFUSE_COLOR)ss << padding(p) << block << "diffuseColor      = " << str(u.diffuseColor     ) << ";" << std::endl;
+      if(prop == Diff::TEXTURE_ID   )ss << padding(p) << block << "textureID         = " << str(u.textureID        ) << ";" << std::endl;
+      if(prop == Diff::DOUBLE_SIDED )ss << padding(p) << block << "doubleSided       = " << str(u.doubleSided      ) << ";" << std::endl;
     }
-    ss << padding(p) << "mem.uniforms["<<i<<"]."<<uniformToStr(u,type)<<"; // "<<uniformName<<std::endl;
   }
   return ss.str();
 }
@@ -385,11 +380,11 @@ std::string listMemoryProp(size_t p,GPUMemory const&mem,Diff const&prop){
   if(prop == Diff::VS2FS        )return listVS2FS      (p,mem);
   if(prop == Diff::BUFFERS      )return listBuffers    (p,mem);
   if(prop == Diff::TEXTURES     )return listTextures   (p,mem);
-  if(prop == Diff::DOUBLE_SIDED )return listUniforms(p,mem,DrawCallUniform::DOUBLE_SIDED);
-  if(prop == Diff::DIFFUSE_COLOR)return listUniforms(p,mem,DrawCallUniform::DIFF_COLOR  );
-  if(prop == Diff::TEXTURE_ID   )return listUniforms(p,mem,DrawCallUniform::TEXTURE_ID  );
-  if(prop == Diff::MODEL_MATRIX )return listUniforms(p,mem,DrawCallUniform::MODEL       );
-  if(prop == Diff::INV_MATRIX   )return listUniforms(p,mem,DrawCallUniform::INV_MODEL   );
+  if(prop == Diff::DOUBLE_SIDED )return listUniforms(p,mem,prop);
+  if(prop == Diff::DIFFUSE_COLOR)return listUniforms(p,mem,prop);
+  if(prop == Diff::TEXTURE_ID   )return listUniforms(p,mem,prop);
+  if(prop == Diff::MODEL_MATRIX )return listUniforms(p,mem,prop);
+  if(prop == Diff::INV_MATRIX   )return listUniforms(p,mem,prop);
     
   return ss.str();
 }
@@ -469,10 +464,19 @@ std::string attribs(size_t p,Check const&check){
   return ss.str();
 }
 
+std::string uniformBlock(size_t p,Check const&check){
+  std::stringstream ss;
+  ss << padding(p) << "Kreslící příkaz je špatný." << std::endl;
+  ss << padding(p) << "Nemáte správně připojený uniformní blok." << std::endl;
+  ss << padding(p) << "Každý kreslící příkaz by měl mít uniformBufferID = "<<drawCallUniformBuffer<<" a uniformBlock = drawID." << std::endl;
+  ss << getDiference(p,check);
+  return ss.str();
+}
+
 std::string shaders(size_t p,Check const&check){
   std::stringstream ss;
   ss << padding(p) << "Paměť grafické karty není správně nastavena." << std::endl;
-  ss << padding(p) << "Špatně jste jste zapsali vertex nebo fragment shader do paměti." << std::endl;
+  ss << padding(p) << "Špatně jste jste zapsali vertex shader, fragment shader nebo prolog do paměti." << std::endl;
   ss << getDiference(p,check);
   return ss.str();
 }
@@ -510,13 +514,14 @@ std::string uniforms(size_t p,Check const&check){
   ss << getDiference(p,check);
   ss << std::endl;
   ss << padding(p) << "Uniformních proměnných je několik." << std::endl;
-  ss << padding(p) << "Uniformní proměnné pro každý vykreslovací příkaz:" << std::endl;
+  ss << padding(p) << "Uniformní proměnné pro každý vykreslovací příkaz jsou v uniformním bloku DrawModelUniforms:" << std::endl;
   ss << padding(p) << "  modelMatrix, invModelMatrix, diffuseColor, textureID, doubleSided." << std::endl;
-  ss << padding(p) << "  mem.uniforms["<<drawCallUniformOffset<<"+drawID*"<<drawCallNofUniforms<<"+"<<MODEL       <<"].m4 = modelMatrix       ;" << std::endl;
-  ss << padding(p) << "  mem.uniforms["<<drawCallUniformOffset<<"+drawID*"<<drawCallNofUniforms<<"+"<<INV_MODEL   <<"].m4 = inverseModelMatrix;" << std::endl;
-  ss << padding(p) << "  mem.uniforms["<<drawCallUniformOffset<<"+drawID*"<<drawCallNofUniforms<<"+"<<DIFF_COLOR  <<"].v4 = diffuseColor      ;" << std::endl;
-  ss << padding(p) << "  mem.uniforms["<<drawCallUniformOffset<<"+drawID*"<<drawCallNofUniforms<<"+"<<TEXTURE_ID  <<"].i1 = textureID         ;" << std::endl;
-  ss << padding(p) << "  mem.uniforms["<<drawCallUniformOffset<<"+drawID*"<<drawCallNofUniforms<<"+"<<DOUBLE_SIDED<<"].v1 = doubleSided       ;" << std::endl;
+  ss << padding(p) << "  auto&u = mem.uniformBuffers["<<drawCallUniformBuffer<<"].block<DrawModelUniforms>(drawID);" << std::endl;
+  ss << padding(p) << "  u.model             = modelMatrix       ;" << std::endl;
+  ss << padding(p) << "  u.invTransposeModel = inverseModelMatrix;" << std::endl;
+  ss << padding(p) << "  u.diffuseColor      = diffuseColor      ;" << std::endl;
+  ss << padding(p) << "  u.textureID         = textureID         ;" << std::endl;
+  ss << padding(p) << "  u.doubleSided       = doubleSided       ;" << std::endl;
   ss << std::endl;
   ss << padding(p) << "Tyto uniformní proměnné musíte správně nastavit a v případě matic i správně vypočítat!" << std::endl;
    
@@ -544,6 +549,7 @@ std::string translatedModelErrors(
     case Diff::NOF_VERTICES :return nofVertices     (p,check);
     case Diff::INDEXING     :return indexing        (p,check);
     case Diff::ATTRIB       :return attribs         (p,check);
+    case Diff::UNIFORM_BLOCK:return uniformBlock    (p,check);
     case Diff::SHADERS      :return shaders         (p,check);
     case Diff::VS2FS        :return vs2fs           (p,check);
     case Diff::BUFFERS      :return buffers         (p,check);
@@ -679,6 +685,7 @@ void checkModelMemory(Model const&model,Diff const&level){
     mem.buffers  ...
     mem.textures ...
     mem.uniforms ...
+    mem.uniformBuffers ...
     ...
   }
 
@@ -9,19 +9,7 @@
 
 namespace tests::model{
 
-enum DrawCallUniform{
-  MODEL         = 0,
-  INV_MODEL        ,
-  DIFF_COLOR       ,
-  TEXTURE_ID       ,
-  DOUBLE_SIDED     ,
-};
-
-uint32_t const drawCallUniformOffset = 10;
-uint32_t const drawCallNofUniforms   = (uint32_t)DOUBLE_SIDED+1;
-
-uint32_t drawCallUniforms(uint32_t drawId);
-uint32_t uniformIdToDrawCallUniform(uint32_t uId);
+uint32_t const drawCallUniformBuffer = 0;
 
 enum class Diff{
   NOF_COMMANDS,
@@ -32,6 +20,7 @@ enum class Diff{
   NOF_VERTICES,
   INDEXING,
   ATTRIB,
+  UNIFORM_BLOCK,
 
   SHADERS,
   VS2FS,
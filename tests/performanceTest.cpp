@@ -10,16 +10,18 @@
 #include <examples/modelMethod.hpp>
 #include <framework/timer.hpp>
 #include <framework/framebuffer.hpp>
+#include <student/postProcess.hpp>
 #include <tests/performanceTest.hpp>
 
 #define ___ std::cerr << __FILE__ << "/" << __LINE__ << std::endl
 
-void runPerformanceTest(size_t framesPerMeasurement) {
+void runPerformanceTest(size_t framesPerMeasurement,FrameLayout layout,DepthFormat depthFormat,bool fxaa) {
   uint32_t width = 500;
   uint32_t height = 500;
   auto method = std::make_shared<modelMethod::Method>();
 
-  auto framebuffer = std::make_shared<Framebuffer>(width,height);
+  auto framebuffer = std::make_shared<Framebuffer>(width,height,layout);
+  framebuffer->depthFormat = depthFormat;
   auto frame = framebuffer->getFrame();
 
   auto perspectiveCamera = basicCamera::PerspectiveCamera();
@@ -47,6 +49,8 @@ void runPerformanceTest(size_t framesPerMeasurement) {
 
   for (size_t i   = 0; i < framesPerMeasurement; ++i){
     method->onDraw(frame,sceneParam);
+    gpu_resolve(frame);
+    if(fxaa)postProcess(frame,fxaaFilter());
   }
   auto const time = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <student/fwd.hpp>
 
-void runPerformanceTest(size_t framesPerMeasurement = 100);
+void runPerformanceTest(size_t framesPerMeasurement = 100,FrameLayout layout = FrameLayout::LINEAR,DepthFormat depthFormat = DepthFormat::FLOAT32,bool fxaa = false);
 
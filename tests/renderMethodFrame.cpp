@@ -33,6 +33,7 @@ std::vector<uint8_t>renderMethodFrame(uint32_t width,uint32_t height){
   auto frame = framebuffer->getFrame();
 
   method->onDraw(frame,sceneParam);
+  gpu_resolve(frame);
 
   auto       f     = frame.color;
   auto const w     = frame.width;
@@ -2,10 +2,21 @@
 #include <framework/application.hpp>
 #include <SDL.h>
 
+#include <vector>
+
 void saveFrame(std::string const&file,Frame const&frame){
   auto surface = SDL_CreateRGBSurface(0, frame.width, frame.height, 24,0,0,0,0);
 
-  copyToSDLSurface(surface,frame.color,frame.width,frame.height);
+  //tiled frame is converted to row major order first
+  std::vector<uint8_t>color;
+  uint8_t const*data = frame.color;
+  if(frame.layout == FrameLayout::TILED){
+    color.resize((size_t)frame.width*frame.height*4);
+    gpu_readFrame(frame,color.data(),nullptr);
+    data = color.data();
+  }
+
+  copyToSDLSurface(surface,data,frame.width,frame.height);
 
   SDL_Surface* rgb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0);
   SDL_SaveBMP(rgb, file.c_str());
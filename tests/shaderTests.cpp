@@ -61,12 +61,14 @@ glm::vec4 computeColor(
   InFragment inF;
   OutFragment outF;
 
-  Uniform uniforms[GPUMemory::maxUniforms];
-  Texture textures[GPUMemory::maxTextures];
+  std::vector<Uniform>uniforms(3);
+  std::vector<Texture>textures = texs;
+  DrawModelUniforms   block;
 
   ShaderInterface si;
-  si.textures = textures;
-  si.uniforms = uniforms;
+  si.textures     = textures.data();
+  si.uniforms     = uniforms.data();
+  si.uniformBlock = &block;
 
   inF.attributes[0].v3 = pos;
   inF.attributes[1].v3 = nor;
@@ -75,12 +77,9 @@ glm::vec4 computeColor(
   
   uniforms[1].v3 = light;
   uniforms[2].v3 = cam  ;
-  uniforms[drawCallUniforms(drawID)+DIFF_COLOR  ].v4 = diffC      ;
-  uniforms[drawCallUniforms(drawID)+TEXTURE_ID  ].i1 = textureID  ;
-  uniforms[drawCallUniforms(drawID)+DOUBLE_SIDED].v1 = doubleSided;
-
-  for(size_t i=0;i<texs.size();++i)
-    textures[i] = texs[i];
+  block.diffuseColor = diffC      ;
+  block.textureID    = textureID  ;
+  block.doubleSided  = doubleSided;
 
   drawModel_fragmentShader(outF,inF,si);
 
@@ -121,9 +120,9 @@ void testLambert(
     Shader ma přístup k uniformním proměnným a texturám:
     si.uniforms[1].v3 - pozice světla
     si.uniforms[2].v3 - pozice kamery
-    si.uniforms[)."<<drawCallUniformOffset<<R".(+gl_DrawID*)."<<drawCallNofUniforms<<R".(+)."<<DrawCallUniform::DIFF_COLOR  <<R".(].v4 - difuzní barva materialu, - pokud není textura
-    si.uniforms[)."<<drawCallUniformOffset<<R".(+gl_DrawID*)."<<drawCallNofUniforms<<R".(+)."<<DrawCallUniform::TEXTURE_ID  <<R".(].i1 - číslo textury nebo -1 pokud textura není.
-    si.uniforms[)."<<drawCallUniformOffset<<R".(+gl_DrawID*)."<<drawCallNofUniforms<<R".(+)."<<DrawCallUniform::DOUBLE_SIDED<<R".(].v1 - 0.f znamená, že je to jednostraný povrch, 1.f znamená, že je to doubleSided
+    si.block<DrawModelUniforms>().diffuseColor - difuzní barva materialu, - pokud není textura
+    si.block<DrawModelUniforms>().textureID    - číslo textury nebo -1 pokud textura není.
+    si.block<DrawModelUniforms>().doubleSided  - 0.f znamená, že je to jednostraný povrch, 1.f znamená, že je to doubleSided
 
     výstupní barva by měla být zapsána do proměnné outFragment.gl_FragColor
 
@@ -199,15 +198,20 @@ SCENARIO("40"){
   inV.gl_DrawID        = 13;
 
 
-  Uniform uniforms[GPUMemory::maxUniforms];
+  std::vector<Uniform>uniforms(3);
+  DrawModelUniforms   block;
 
   ShaderInterface si;
-  si.uniforms = uniforms;
+  si.uniforms     = uniforms.data();
+  si.uniformBlock = &block;
 
-  uniforms[0].m4 = proj*view;
-  uniforms[drawCallUniforms(inV.gl_DrawID)+DrawCallUniform::MODEL    ].m4 = model;
-  uniforms[drawCallUniforms(inV.gl_DrawID)+DrawCallUniform::INV_MODEL].m4 = itm  ;
+  uniforms[0].m4          = proj*view;
+  block.model             = model;
+  block.invTransposeModel = itm  ;
 
+  Uniform constants[maxConstants];
+  drawModel_prologue(constants,si);
+  si.constants = constants;
 
   drawModel_vertexShader(outV,inV,si);
 
@@ -233,11 +237,14 @@ SCENARIO("40"){
     viewProjectionMatrix je výsledkem násobení projection*view.
     invModelMatrix je inverzní transponovaná modelová matice.
     viewProjectionMatrix je jako jediná stejná pro celý model.
-    modelMatrix, invModelMatrix se liší pro každý vykreslovací příkaz.
+    modelMatrix, invModelMatrix se liší pro každý vykreslovací příkaz a jsou v jeho uniformním bloku.
 
     si.uniforms[0].m4 // viewProjectionMatrix
-    si.uniforms[)."<<drawCallUniformOffset<<R".(+gl_Draw*)."<<drawCallNofUniforms<<R".(+)."<<DrawCallUniform::MODEL<<R".(].m4 // modelMatrix
-    si.uniforms[)."<<drawCallUniformOffset<<R".(+gl_Draw*)."<<drawCallNofUniforms<<R".(+)."<<DrawCallUniform::INV_MODEL<<R".(].m4 // invModelMatrix
+    si.block<DrawModelUniforms>().model             // modelMatrix
+    si.block<DrawModelUniforms>().invTransposeModel // invModelMatrix
+
+    Prolog drawModel_prologue se spouští jednou pro kreslící příkaz a jeho výsledek je v si.constants.
+    si.constants[0].m4 // viewProjectionMatrix*modelMatrix
 
     Výstup shaderu je pozice výstupního vrcholu ve clip space - gl_Position a 
     čtyři atributy: pozice ve world-space, normála ve world space, texturovací souřadnice a gl_DrawID.
@@ -3,8 +3,11 @@
 #include <tests/testCommon.hpp>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 #include <sstream>
 #include <iostream>
+#include <limits>
+#include <algorithm>
 
 void drawModel_vertexShader  (OutVertex  &,InVertex   const&,ShaderInterface const&);
 void drawModel_fragmentShader(OutFragment&,InFragment const&,ShaderInterface const&);
@@ -134,6 +137,13 @@ template<>std::string str(IndexType const&i){
   return "unknown";
 }
 
+template<>std::string str(Topology const&t){
+  if(t==Topology::TRIANGLES     )return "Topology::TRIANGLES"     ;
+  if(t==Topology::TRIANGLE_STRIP)return "Topology::TRIANGLE_STRIP";
+  if(t==Topology::TRIANGLE_FAN  )return "Topology::TRIANGLE_FAN"  ;
+  return "unknown";
+}
+
 template<>std::string str(AttributeType const&a){
   switch(a){
     case AttributeType::EMPTY:return "AttributeType::EMPTY";
@@ -145,6 +155,26 @@ template<>std::string str(AttributeType const&a){
     case AttributeType::UVEC2:return "AttributeType::UVEC2";
     case AttributeType::UVEC3:return "AttributeType::UVEC3";
     case AttributeType::UVEC4:return "AttributeType::UVEC4";
+    case AttributeType::HALF     :return "AttributeType::HALF";
+    case AttributeType::HALF2    :return "AttributeType::HALF2";
+    case AttributeType::HALF3    :return "AttributeType::HALF3";
+    case AttributeType::HALF4    :return "AttributeType::HALF4";
+    case AttributeType::UNORM8   :return "AttributeType::UNORM8";
+    case AttributeType::UNORM8x2 :return "AttributeType::UNORM8x2";
+    case AttributeType::UNORM8x3 :return "AttributeType::UNORM8x3";
+    case AttributeType::UNORM8x4 :return "AttributeType::UNORM8x4";
+    case AttributeType::SNORM8   :return "AttributeType::SNORM8";
+    case AttributeType::SNORM8x2 :return "AttributeType::SNORM8x2";
+    case AttributeType::SNORM8x3 :return "AttributeType::SNORM8x3";
+    case AttributeType::SNORM8x4 :return "AttributeType::SNORM8x4";
+    case AttributeType::UNORM16  :return "AttributeType::UNORM16";
+    case AttributeType::UNORM16x2:return "AttributeType::UNORM16x2";
+    case AttributeType::UNORM16x3:return "AttributeType::UNORM16x3";
+    case AttributeType::UNORM16x4:return "AttributeType::UNORM16x4";
+    case AttributeType::SNORM16  :return "AttributeType::SNORM16";
+    case AttributeType::SNORM16x2:return "AttributeType::SNORM16x2";
+    case AttributeType::SNORM16x3:return "AttributeType::SNORM16x3";
+    case AttributeType::SNORM16x4:return "AttributeType::SNORM16x4";
     default: return "unknown";
   }
 }
@@ -152,6 +182,10 @@ template<> std::string str(CommandType const&a){
   switch(a){
     case CommandType::CLEAR:return "clear";
     case CommandType::DRAW :return "draw" ;
+    case CommandType::MULTI_DRAW:return "multiDraw";
+    case CommandType::BEGIN_QUERY:return "beginQuery";
+    case CommandType::END_QUERY:return "endQuery";
+    case CommandType::BIND_FRAMEBUFFER:return "bindFramebuffer";
     default:return "unknown";
   }
 }
@@ -200,6 +234,9 @@ float getDepth(Frame const&frame,glm::uvec2 const&pix){
 
 void  writeDepth(Frame&frame,glm::uvec2 const&pix,float d){
   frame.depth[pix.y*frame.width+pix.x] = d;
+  //depth can be increased, max depth of the tile is no longer known
+  if(frame.hiZ)
+    frame.hiZ[(pix.y/hiZTileSize)*((frame.width+hiZTileSize-1)/hiZTileSize)+pix.x/hiZTileSize] = std::numeric_limits<float>::infinity();
 }
 
 glm::uvec4 floatColorToBytes(glm::vec4 const&col){
@@ -215,6 +252,20 @@ std::shared_ptr<MemCb>createMemCb(){
   return std::make_shared<MemCb>();
 }
 
+void unpackAttribute(Attribute&att,uint8_t const*ptr,AttributeType type){
+  auto&res = att.v4;
+  auto p16 = (uint16_t const*)ptr;
+  for(uint32_t c=0;c<attributeComponents(type);++c){
+    switch((uint32_t)type>>4){
+      case 1:res[c] = glm::unpackHalf1x16 (p16[c]);break;
+      case 2:res[c] = glm::unpackUnorm1x8 (ptr[c]);break;
+      case 3:res[c] = glm::unpackSnorm1x8 (ptr[c]);break;
+      case 4:res[c] = glm::unpackUnorm1x16(p16[c]);break;
+      case 5:res[c] = glm::unpackSnorm1x16(p16[c]);break;
+    }
+  }
+}
+
 bool operator==(Attribute const&a,Attribute const&b){
   return a.v4 == b.v4;
 }
@@ -225,32 +276,47 @@ bool operator==(InVertex const&a,InVertex const&b){
   return a.gl_VertexID == b.gl_VertexID;
 }
 
-std::vector<InVertex>computeExpectedInVertices(GPUMemory const&mem,DrawCommand const&cmd,uint32_t drawID){
-  std::vector<InVertex>result;
-  auto const&vao = cmd.vao;
-  for(uint32_t i=0;i<cmd.nofVertices;++i){
+void computeExpectedInVertices(std::vector<InVertex>&result,GPUMemory const&mem,VertexArray const&vao,DrawRecord const&draw,Topology topology){
+  uint32_t const restart = 0xffffffffu >> (32-8*(uint32_t)vao.indexType);
+  for(uint32_t n=0;n<draw.nofInstances;++n)
+  for(uint32_t i=0;i<draw.nofVertices;++i){
     InVertex inV;
     OutVertex outV;
+    inV.gl_InstanceID = n;
+    inV.gl_DrawID     = draw.drawID;
     if(vao.indexBufferID>=0){
-      auto ind = (uint8_t*)mem.buffers[vao.indexBufferID].data+vao.indexOffset;
+      auto ind = (uint8_t*)mem.buffers[vao.indexBufferID].data+vao.indexOffset+draw.indexOffset;
       if(vao.indexType == IndexType::UINT8 )inV.gl_VertexID = ((uint8_t *)ind)[i];
       if(vao.indexType == IndexType::UINT16)inV.gl_VertexID = ((uint16_t*)ind)[i];
       if(vao.indexType == IndexType::UINT32)inV.gl_VertexID = ((uint32_t*)ind)[i];
+      //restart index is not sent to vertex shader
+      if(topology != Topology::TRIANGLES && vao.primitiveRestart && inV.gl_VertexID == restart)continue;
     }else{
       inV.gl_VertexID = i;
-      inV.gl_DrawID   = drawID;
     }
+    inV.gl_VertexID += draw.baseVertex;
     for(uint32_t a=0;a<maxAttributes;++a){
-      auto const&at = cmd.vao.vertexAttrib[a];
+      auto const&at = vao.vertexAttrib[a];
       if(at.bufferID<0)continue;
-      auto buf = mem.buffers[at.bufferID].data;
-      if(at.type == AttributeType::FLOAT)inV.attributes[a].v1 = *(float    *)(((uint8_t*)buf)+at.stride*inV.gl_VertexID+at.offset);
-      if(at.type == AttributeType::VEC2 )inV.attributes[a].v2 = *(glm::vec2*)(((uint8_t*)buf)+at.stride*inV.gl_VertexID+at.offset);
-      if(at.type == AttributeType::VEC3 )inV.attributes[a].v3 = *(glm::vec3*)(((uint8_t*)buf)+at.stride*inV.gl_VertexID+at.offset);
-      if(at.type == AttributeType::VEC4 )inV.attributes[a].v4 = *(glm::vec4*)(((uint8_t*)buf)+at.stride*inV.gl_VertexID+at.offset);
+      auto buf = ((uint8_t*)mem.buffers[at.bufferID].data)+at.offset;
+      auto el  = at.divisor?inV.gl_InstanceID/at.divisor:inV.gl_VertexID;
+      if(at.type == AttributeType::FLOAT)inV.attributes[a].v1 = *(float    *)(buf+at.stride*el);
+      if(at.type == AttributeType::VEC2 )inV.attributes[a].v2 = *(glm::vec2*)(buf+at.stride*el);
+      if(at.type == AttributeType::VEC3 )inV.attributes[a].v3 = *(glm::vec3*)(buf+at.stride*el);
+      if(at.type == AttributeType::VEC4 )inV.attributes[a].v4 = *(glm::vec4*)(buf+at.stride*el);
+      if((uint32_t)at.type >= 16)unpackAttribute(inV.attributes[a],buf+at.stride*el,at.type);
     }
     result.push_back(inV);
   }
+}
+
+std::vector<InVertex>computeExpectedInVertices(GPUMemory const&mem,DrawCommand const&cmd,uint32_t drawID){
+  std::vector<InVertex>result;
+  DrawRecord draw;
+  draw.nofVertices  = cmd.nofVertices ;
+  draw.nofInstances = cmd.nofInstances;
+  draw.drawID       = drawID          ;
+  computeExpectedInVertices(result,mem,cmd.vao,draw,cmd.topology);
   return result;
 }
 
@@ -275,6 +341,17 @@ std::vector<std::shared_ptr<CommandDump>>computeExpectedDump(GPUMemory const&mem
       dump->programID = dc.programID;
       res.push_back(dump);
     }
+    if(cmd.type == CommandType::MULTI_DRAW){
+      auto const&mc = cmd.data.multiDrawCommand;
+      auto dump = std::make_shared<DrawDump>((void*)mem.programs[mc.programID].vertexShader);
+      auto records = (DrawRecord const*)((uint8_t const*)mem.buffers[mc.drawBufferID].data+mc.drawOffset);
+      for(uint32_t d=0;d<mc.nofDraws;++d)
+        computeExpectedInVertices(dump->inVertices,mem,mc.vao,records[d],mc.topology);
+      drawID += mc.nofDraws;
+      dump->vao       = mc.vao      ;
+      dump->programID = mc.programID;
+      res.push_back(dump);
+    }
   }
 
   return res;
@@ -321,6 +398,7 @@ DumpDiff isCommandBufferDumpSame(
         auto const&sIn = sIns.at(v);
         if(eIn.gl_DrawID != sIn.gl_DrawID)return filterErrorLevel(DumpDiff::DIFFERENT_DRAWID,level);
         if(eIn.gl_VertexID != sIn.gl_VertexID)return filterErrorLevel(DumpDiff::DIFFERENT_VERTEXID,level);
+        if(eIn.gl_InstanceID != sIn.gl_InstanceID)return filterErrorLevel(DumpDiff::DIFFERENT_INSTANCEID,level);
         for(size_t a=0;a<maxAttributes;++a)
           if(eIn.attributes[a].v4 != sIn.attributes[a].v4)return filterErrorLevel(DumpDiff::DIFFERENT_ATTRIBUTE,level);
       }
@@ -358,7 +436,7 @@ std::string clearCommandToStr(size_t p,ClearDump const*cc){
 }
 
 int32_t findProgramID(GPUMemory const&mem,void*ptr){
-  for(uint32_t i=0;i<mem.maxPrograms;++i)
+  for(uint32_t i=0;i<mem.programs.size();++i)
     if((void*)mem.programs[i].vertexShader == ptr)return i;
   return -1;
 }
@@ -392,8 +470,9 @@ std::string drawCommandToStr(size_t p,DrawDump const*cc){
   for(size_t i=0;i<verts.size();++i){
     auto const& v = verts.at(i);
     ss << padding(p+2) << "vertex" << i << ":" << std::endl;
-    ss << padding(p+4) << "gl_VertexID: " << v.gl_VertexID << std::endl;
-    ss << padding(p+4) << "gl_DrawID  : " << v.gl_DrawID   << std::endl;
+    ss << padding(p+4) << "gl_VertexID  : " << v.gl_VertexID   << std::endl;
+    ss << padding(p+4) << "gl_DrawID    : " << v.gl_DrawID     << std::endl;
+    ss << padding(p+4) << "gl_InstanceID: " << v.gl_InstanceID << std::endl;
     for(size_t a=0;a<maxAttributes;++a){
       auto const& type = cc->vao.vertexAttrib[a].type;
       auto const& att  = v.attributes[a];
@@ -407,6 +486,7 @@ std::string drawCommandToStr(size_t p,DrawDump const*cc){
       if(type == AttributeType::UVEC2)ss << str(att.u2) << std::endl;
       if(type == AttributeType::UVEC3)ss << str(att.u3) << std::endl;
       if(type == AttributeType::UVEC4)ss << str(att.u4) << std::endl;
+      if((uint32_t)type >= 16       )ss << str(att.v4) << std::endl;
     }
   }
   return ss.str();
@@ -585,6 +665,35 @@ std::string differentVertexIDStr(
   return ss.str();
 }
 
+std::string listInstanceID(
+    size_t p,
+    CmdsDump const&dump){
+  std::stringstream ss;
+
+  uint32_t counter = 0;
+  for(auto const&c:dump){
+    if(c->type != CommandType::DRAW)continue;
+    ss << padding(p) << "drawCommand" << counter++ << ": ";
+    for(auto const&v:c->asDraw()->inVertices)
+      ss << v.gl_InstanceID << ", ";
+    ss << std::endl;
+  }
+  return ss.str();
+}
+
+std::string differentInstanceIDStr(
+    size_t p,
+    CmdsDump const&expected,
+    CmdsDump const&student ){
+  std::stringstream ss;
+  ss << padding(p) << "Liší se gl_InstanceID." << std::endl;
+  ss << padding(p) << "Očekávané hodnoty gl_InstanceID:" << std::endl;
+  ss << listInstanceID(p+2,expected);
+  ss << padding(p) << "Vaše hodnoty gl_InstanceID:" << std::endl;
+  ss << listInstanceID(p+2,student );
+  return ss.str();
+}
+
 std::string listAttributes(
     size_t p,
     CmdsDump const&dump    ,
@@ -611,6 +720,7 @@ std::string listAttributes(
         if(type == AttributeType::UVEC2)ss << str(att.u2) << ", ";
         if(type == AttributeType::UVEC3)ss << str(att.u3) << ", ";
         if(type == AttributeType::UVEC4)ss << str(att.u4) << ", ";
+        if((uint32_t)type >= 16       )ss << str(att.v4) << ", ";
       }
       ss << std::endl;
     }
@@ -646,6 +756,7 @@ std::string commandBufferDumpToStr(
     case DumpDiff::DIFFERENT_NOF_VERTICES :return differentNofVerticesStr (p,expected,student);
     case DumpDiff::DIFFERENT_DRAWID       :return differentDrawIDStr      (p,expected,student);
     case DumpDiff::DIFFERENT_VERTEXID     :return differentVertexIDStr    (p,expected,student);
+    case DumpDiff::DIFFERENT_INSTANCEID   :return differentInstanceIDStr  (p,expected,student);
     case DumpDiff::DIFFERENT_ATTRIBUTE    :return differentAttributeStr   (p,expected,student);
 
     default:return padding(p) + "Nemáte problém.";
@@ -732,8 +843,8 @@ void vertexShaderInject(OutVertex&outVertex,InVertex const&inVertex,ShaderInterf
     outVertex = dumpInject.outVertices.at(inVertex.gl_VertexID);
 }
 
-Uniform unif[GPUMemory::maxUniforms];
-Texture texs[GPUMemory::maxTextures];
+std::vector<Uniform>unif;
+std::vector<Texture>texs;
 
 void fragmentShaderDump(OutFragment&,InFragment const&inF,ShaderInterface const&){
   dumpInject.inFragments.push_back(inF);
@@ -754,6 +865,10 @@ void clearFrame(Frame&frame,glm::uvec3 const&color,float d){
       frame.color[pix*4+3] = 0;
       frame.depth[pix] = d;
     }
+  if(frame.hiZ)
+    std::fill(frame.hiZ,frame.hiZ+((frame.width+hiZTileSize-1)/hiZTileSize)*((frame.height+hiZTileSize-1)/hiZTileSize),d);
+  if(frame.fastClear&&frame.fastClear->tiles)
+    std::fill(frame.fastClear->tiles,frame.fastClear->tiles+((frame.width+hiZTileSize-1)/hiZTileSize)*((frame.height+hiZTileSize-1)/hiZTileSize),0);
 }
 
 void clearFrame(Frame&frame,glm:: vec3 const&c,float d){
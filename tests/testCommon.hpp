@@ -56,6 +56,7 @@ template<> std::string str(glm::ivec4 const&a);
 
 template<> std::string str(glm::mat4 const&m);
 template<> std::string str(IndexType const&i);
+template<> std::string str(Topology const&t);
 template<> std::string str(AttributeType const&a);
 template<> std::string str(CommandType const&a);
 std::string padding(size_t n=2);
@@ -71,7 +72,7 @@ void       writeColor(Frame&frame,glm::uvec2 const&pix,glm::uvec4 const&c);
 float      getDepth(Frame const&frame,glm::uvec2 const&pix);
 void       writeDepth(Frame&frame,glm::uvec2 const&pix,float d);
 
-std::vector<InVertex>computeExpectedInVertices(GPUMemory const&mem,DrawCommand const&cmd);
+std::vector<InVertex>computeExpectedInVertices(GPUMemory const&mem,DrawCommand const&cmd,uint32_t drawID = 0);
 
 bool operator==(VertexAttrib const&a,VertexAttrib const&b);
 bool operator==(InVertex const&a,InVertex const&b);
@@ -136,8 +137,8 @@ struct FragmentShaderDump{
   FragmentShaderDump();
   void*fs = nullptr;
   std::vector<InFragment>inFragments;
-  Uniform unif[GPUMemory::maxUniforms];
-  Texture texs[GPUMemory::maxTextures];
+  std::vector<Uniform>unif;
+  std::vector<Texture>texs;
 };
 
 using CmdsDump = std::vector<std::shared_ptr<CommandDump>>;
@@ -178,6 +179,7 @@ enum class DumpDiff{
   DIFFERENT_NOF_VERTICES,
   DIFFERENT_DRAWID,
   DIFFERENT_VERTEXID,
+  DIFFERENT_INSTANCEID,
   DIFFERENT_ATTRIBUTE,
   DIFFERENT_SHADERINTERFACE,
   SAME,
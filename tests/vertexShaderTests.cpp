@@ -8,6 +8,7 @@
 #include <sstream>
 #include<functional>
 #include<map>
+#include<set>
 
 #include <algorithm>
 #include <numeric>
@@ -415,3 +416,409 @@ SCENARIO("09"){
   REQUIRE(false);
 }
 
+
+SCENARIO("43"){
+  std::cerr << "43 - vertex shader, half float and normalized attributes" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<uint16_t> halfs   = {0x3c00,0xc000,0x3800,0x0000,0x7bff,0xb400};
+  std::vector<int8_t  > snorms  = {127,-127,-128,0, 64,-64,1,-1, 0,127,-1,33};
+  std::vector<uint16_t> unorms  = {0,65535,32768,1000,0,0,65535,0,12345};
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(halfs );
+  mem.buffers[1] = vectorToBuffer(snorms);
+  mem.buffers[2] = vectorToBuffer(unorms);
+  mem.programs[0].vertexShader   = vertexShaderDump0  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+
+  VertexArray vao;
+  vao.vertexAttrib[0].bufferID   = 0;
+  vao.vertexAttrib[0].type       = AttributeType::HALF2;
+  vao.vertexAttrib[0].stride     = sizeof(uint16_t)*2;
+  vao.vertexAttrib[0].offset     = 0;
+
+  vao.vertexAttrib[1].bufferID   = 1;
+  vao.vertexAttrib[1].type       = AttributeType::SNORM8x4;
+  vao.vertexAttrib[1].stride     = sizeof(int8_t)*4;
+  vao.vertexAttrib[1].offset     = 0;
+
+  vao.vertexAttrib[2].bufferID   = 2;
+  vao.vertexAttrib[2].type       = AttributeType::UNORM16x2;
+  vao.vertexAttrib[2].stride     = sizeof(uint16_t)*3;
+  vao.vertexAttrib[2].offset     = sizeof(uint16_t);
+
+  pushDrawCommand(cb,3,0,vao);
+
+  dumpInject.init(&mem);
+
+  gpu_execute(mem,cb);
+
+  auto check = checkDump(mem,cb,DumpDiff::DIFFERENT_ATTRIBUTE);
+
+  if(check.status == DumpDiff::SAME)return;
+
+  std::cerr << R".(
+
+  Tento test kontroluje, jestli se do vertex shaderu posílají správně dekódované komprimované vertex attributy.
+
+  Uživatel si vytvořil tři buffery: 16-bitové floaty (HALF2), 8-bitové znaménkové normalizované inty (SNORM8x4)
+  a 16-bitové bezznaménkové normalizované inty (UNORM16x2) s offsetem 2 bajty a krokem 6 bajtů.
+  Vertex shader by měl obdržet floaty, nevyužité komponenty zůstávají nezměněny.)." << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << commandBufferDumpToStr(2,check);
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}
+
+SCENARIO("44"){
+  std::cerr << "44 - vertex shader, instancing, gl_InstanceID, divisor" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<glm::vec2> vert    = {glm::vec2(-1.f,-1.f),glm::vec2(1.f,-1.f),glm::vec2(-1.f,1.f)};
+  std::vector<glm::vec3> offsets = {glm::vec3(0.f,1.f,2.f),glm::vec3(3.f,4.f,5.f)};
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(vert   );
+  mem.buffers[1] = vectorToBuffer(offsets);
+  mem.programs[0].vertexShader   = vertexShaderDump0  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+
+  VertexArray vao;
+  vao.vertexAttrib[0].bufferID   = 0;
+  vao.vertexAttrib[0].type       = AttributeType::VEC2;
+  vao.vertexAttrib[0].stride     = sizeof(glm::vec2);
+  vao.vertexAttrib[0].offset     = 0;
+
+  vao.vertexAttrib[1].bufferID   = 1;
+  vao.vertexAttrib[1].type       = AttributeType::VEC3;
+  vao.vertexAttrib[1].stride     = sizeof(glm::vec3);
+  vao.vertexAttrib[1].offset     = 0;
+  vao.vertexAttrib[1].divisor    = 2;
+
+  pushDrawCommand(cb,3,0,vao,false,4);
+
+  dumpInject.init(&mem);
+
+  gpu_execute(mem,cb);
+
+  auto check = checkDump(mem,cb,DumpDiff::DIFFERENT_ATTRIBUTE);
+
+  if(check.status == DumpDiff::SAME)return;
+
+  std::cerr << R".(
+
+  Tento test kontroluje instancované kreslení.
+
+  Uživatel vykreslil jeden trojúhelník ve 4 instancích (nofInstances = 4).
+  Vertex shader by se měl spustit pro každý vrchol každé instance a obdržet správné gl_InstanceID.
+  Atribut 1 má divisor = 2, takže se posouvá o jeden prvek každé 2 instance (nezávisle na gl_VertexID).)." << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << commandBufferDumpToStr(2,check);
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}
+
+void stripCoverageTest(Topology topology,std::vector<uint32_t>const&indices){
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(20,20);
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(indices);
+  mem.programs[0].vertexShader   = vertexShaderInject;
+  mem.programs[0].fragmentShader = fragmentShaderDump;
+
+  VertexArray vao;
+  vao.indexBufferID = 0;
+  vao.indexType     = IndexType::UINT32;
+
+  pushDrawCommand(cb,(uint32_t)indices.size(),0,vao,true,1,topology);
+
+  dumpInject.init(&mem);
+  dumpInject.inFragments.clear();
+  dumpInject.outVertices.push_back({{},glm::vec4(-1.f,-1.f,0.f,1.f)});
+  dumpInject.outVertices.push_back({{},glm::vec4(+1.f,-1.f,0.f,1.f)});
+  dumpInject.outVertices.push_back({{},glm::vec4(-1.f,+1.f,0.f,1.f)});
+  dumpInject.outVertices.push_back({{},glm::vec4(+1.f,+1.f,0.f,1.f)});
+
+  gpu_execute(mem,cb);
+
+  std::set<std::pair<int,int>>covered;
+  for(auto const&f:dumpInject.inFragments)
+    covered.insert(std::make_pair((int)f.gl_FragCoord.x,(int)f.gl_FragCoord.y));
+
+  if(covered.size() == 20*20)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Čtverec přes celou obrazovku složený ze dvou trojúhelníků ()."<<str(topology)<<R".() by měl pokrýt všechny pixely.
+  Zapnutý backface culling ověřuje, že se u stripu střídá pořadí vrcholů lichých trojúhelníků,
+  aby všechny trojúhelníky měly stejnou orientaci.
+  Pokryto bylo )."<<covered.size()<<R".( pixelů z )."<<20*20<<R".(.)." << std::endl;
+
+  std::cerr << commandBufferToStr(2,cb);
+  REQUIRE(false);
+}
+
+SCENARIO("46"){
+  std::cerr << "46 - vertex shader, triangle strip, triangle fan, primitive restart" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<float   > vert    = {0.f,1.f,2.f,3.f,4.f,5.f,6.f,7.f};
+  std::vector<uint16_t> indices = {0,1,2,3,0xffff,4,5,6,0xffff,7,6,5};
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(vert   );
+  mem.buffers[1] = vectorToBuffer(indices);
+  mem.programs[0].vertexShader   = vertexShaderDump0  ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+  mem.programs[1].vertexShader   = vertexShaderDump1  ;
+  mem.programs[1].fragmentShader = fragmentShaderEmpty;
+
+  VertexArray vao;
+  vao.vertexAttrib[0].bufferID = 0;
+  vao.vertexAttrib[0].type     = AttributeType::FLOAT;
+  vao.vertexAttrib[0].stride   = sizeof(float);
+
+  VertexArray ivao = vao;
+  ivao.indexBufferID    = 1;
+  ivao.indexType        = IndexType::UINT16;
+  ivao.primitiveRestart = true;
+
+  pushDrawCommand(cb,5,0,vao ,false,1,Topology::TRIANGLE_FAN  );
+  pushDrawCommand(cb,(uint32_t)indices.size(),1,ivao,false,1,Topology::TRIANGLE_STRIP);
+
+  dumpInject.init(&mem);
+
+  gpu_execute(mem,cb);
+
+  auto check = checkDump(mem,cb,DumpDiff::DIFFERENT_ATTRIBUTE);
+
+  if(check.status != DumpDiff::SAME){
+    std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje kreslení triangle stripu a triangle fanu (DrawCommand::topology).
+  Vertex shader by se měl spustit právě jednou pro každý vrchol, sdílené vrcholy sousedních trojúhelníků se nestínují znovu.
+  Index se všemi bity nastavenými na 1 (0xffff pro UINT16) při zapnutém vao.primitiveRestart
+  začíná nový strip a vertex shader se pro něj nespouští.)." << std::endl;
+
+    std::cerr << std::endl;
+    std::cerr << commandBufferDumpToStr(2,check);
+    std::cerr << std::endl;
+
+    std::cerr << gpuMemoryToStr(2,mem,cb);
+    std::cerr << commandBufferToStr(2,cb);
+
+    REQUIRE(false);
+  }
+
+  stripCoverageTest(Topology::TRIANGLE_STRIP,{0,1,2,3});
+  stripCoverageTest(Topology::TRIANGLE_FAN  ,{0,1,3,2});
+}
+
+SCENARIO("48"){
+  std::cerr << "48 - vertex shader, gpu memory tables grow on demand" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<float> vert = {0.f,1.f,2.f,3.f,4.f,5.f};
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers [150] = vectorToBuffer(vert);
+  mem.programs[120].vertexShader   = vertexShaderDump0  ;
+  mem.programs[120].fragmentShader = fragmentShaderEmpty;
+  mem.uniforms[20000].v1 = 1.f;
+
+  VertexArray vao;
+  vao.vertexAttrib[0].bufferID = 150;
+  vao.vertexAttrib[0].type     = AttributeType::FLOAT;
+  vao.vertexAttrib[0].stride   = sizeof(float);
+
+  pushDrawCommand(cb,6,120,vao);
+
+  dumpInject.init(&mem);
+
+  gpu_execute(mem,cb);
+
+  auto check = checkDump(mem,cb,DumpDiff::DIFFERENT_ATTRIBUTE);
+
+  GPUMemory const&cmem = mem;
+  bool const defaults = cmem.buffers[1000].data == nullptr && cmem.programs[1000].vertexShader == nullptr;
+
+  if(check.status == DumpDiff::SAME && defaults)return;
+
+  std::cerr << R".(
+
+  Tento test kontroluje, že paměť grafické karty (GPUMemory) roste podle potřeby.
+  Uživatel použil buffer 150, program 120 a uniformní proměnnou 20000.
+  Čtení nikdy nezapsaného zdroje by mělo vrátit výchozí hodnotu.)." << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << commandBufferDumpToStr(2,check);
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}
+
+std::vector<float>vertexShaderValues;
+
+void uniformBlockVS(OutVertex&,InVertex const&,ShaderInterface const&si){
+  vertexShaderValues.push_back(si.uniformBlock?si.block<float>():-1.f);
+}
+
+SCENARIO("49"){
+  std::cerr << "49 - vertex shader, uniform block bound to draw" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<DrawRecord> records = {
+    {3,1,0,0,1},
+    {3,1,0,0,0},
+  };
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(records);
+  mem.programs[0].vertexShader   = uniformBlockVS     ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+  for(uint32_t i=0;i<3;++i)
+    mem.uniformBuffers[2].block<float>(i) = (float)i*10.f;
+
+  pushDrawCommand     (cb,3,0,{},false,1,Topology::TRIANGLES,2,2);
+  pushDrawCommand     (cb,3,0,{});
+  pushMultiDrawCommand(cb,0,2,0,{},false,0,Topology::TRIANGLES,2);
+
+  vertexShaderValues.clear();
+
+  gpu_execute(mem,cb);
+
+  std::vector<float>expected = {20.f,20.f,20.f,-1.f,-1.f,-1.f,10.f,10.f,10.f,0.f,0.f,0.f};
+
+  if(vertexShaderValues == expected)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje připojení uniformního bloku ke kreslícímu příkazu.
+  DrawCommand připojuje blok mem.uniformBuffers[uniformBufferID].block(uniformBlock).
+  MultiDrawCommand připojuje pro každé kreslení blok s indexem DrawRecord::drawID.
+  Pokud je uniformBufferID == -1, je si.uniformBlock == nullptr.
+  Shader čte blok pomocí si.block<T>().)." << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << "  Očekávané hodnoty bloku ve vertex shaderu: ";
+  for(auto const&v:expected)std::cerr << v << ", ";
+  std::cerr << std::endl;
+  std::cerr << "  Vaše hodnoty bloku ve vertex shaderu     : ";
+  for(auto const&v:vertexShaderValues)std::cerr << v << ", ";
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}
+
+uint32_t prologueCounter = 0;
+
+void countingPrologue(Uniform*constants,ShaderInterface const&si){
+  prologueCounter++;
+  constants[0].v1 = si.uniforms[0].v1 + si.block<float>();
+}
+
+void prologueVS(OutVertex&,InVertex const&,ShaderInterface const&si){
+  vertexShaderValues.push_back(si.constants?si.constants[0].v1:-1.f);
+}
+
+SCENARIO("50"){
+  std::cerr << "50 - vertex shader, program prologue runs once per draw" << std::endl;
+
+  MEMCB();
+
+  auto framebuffer = std::make_shared<Framebuffer>(100,100);
+
+  std::vector<DrawRecord> records = {
+    {3,1,0,0,1},
+    {3,1,0,0,0},
+  };
+
+  mem.framebuffer = framebuffer->getFrame();
+  mem.buffers[0] = vectorToBuffer(records);
+  mem.programs[0].vertexShader   = prologueVS         ;
+  mem.programs[0].fragmentShader = fragmentShaderEmpty;
+  mem.programs[0].prologue       = countingPrologue   ;
+  mem.programs[1].vertexShader   = prologueVS         ;
+  mem.programs[1].fragmentShader = fragmentShaderEmpty;
+  mem.uniforms[0].v1 = 100.f;
+  for(uint32_t i=0;i<3;++i)
+    mem.uniformBuffers[0].block<float>(i) = (float)i;
+
+  pushDrawCommand     (cb,6,0,{},false,2,Topology::TRIANGLES,0,2);
+  pushDrawCommand     (cb,3,1,{});
+  pushMultiDrawCommand(cb,0,2,0,{},false,0,Topology::TRIANGLES,0);
+
+  vertexShaderValues.clear();
+  prologueCounter = 0;
+
+  gpu_execute(mem,cb);
+
+  std::vector<float>expected = {
+    102.f,102.f,102.f,102.f,102.f,102.f,102.f,102.f,102.f,102.f,102.f,102.f,
+    -1.f,-1.f,-1.f,
+    101.f,101.f,101.f,
+    100.f,100.f,100.f};
+
+  if(vertexShaderValues == expected && prologueCounter == 3)return;
+
+  std::cerr << R".(
+  TEST SELHAL!
+
+  Tento test kontroluje prolog programu (Program::prologue).
+  Prolog se spouští jednou pro každé kreslení (DrawCommand nebo DrawRecord multi draw příkazu),
+  ne pro každý vrchol nebo instanci.
+  Prolog zapíše konstanty, které shadery čtou pomocí si.constants.
+  Pokud program nemá prolog, je si.constants == nullptr.)." << std::endl;
+
+  std::cerr << std::endl;
+  std::cerr << "  Očekávaný počet spuštění prologu: 3" << std::endl;
+  std::cerr << "  Váš počet spuštění prologu      : " << prologueCounter << std::endl;
+  std::cerr << "  Očekávané konstanty ve vertex shaderu: ";
+  for(auto const&v:expected)std::cerr << v << ", ";
+  std::cerr << std::endl;
+  std::cerr << "  Vaše konstanty ve vertex shaderu     : ";
+  for(auto const&v:vertexShaderValues)std::cerr << v << ", ";
+  std::cerr << std::endl;
+
+  std::cerr << gpuMemoryToStr(2,mem,cb);
+  std::cerr << commandBufferToStr(2,cb);
+
+  REQUIRE(false);
+}